@@ -0,0 +1,97 @@
+#include "asyncutil.h"
+
+#include <utility>
+
+namespace async_util {
+
+namespace asio = boost::asio;
+
+/* -------- Semaphore::Guard -------- */
+
+Semaphore::Guard::Guard(Semaphore* sem) noexcept
+    : sem_(sem) {}
+
+Semaphore::Guard::Guard(Guard&& other) noexcept
+    : sem_(std::exchange(other.sem_, nullptr)) {}
+
+Semaphore::Guard& Semaphore::Guard::operator=(Guard&& other) noexcept {
+    if (this != &other) {
+        Release();
+        sem_ = std::exchange(other.sem_, nullptr);
+    }
+    return *this;
+}
+
+Semaphore::Guard::~Guard() {
+    Release();
+}
+
+void Semaphore::Guard::Release() noexcept {
+    if (sem_) {
+        std::exchange(sem_, nullptr)->Release();
+    }
+}
+
+/* -------- Semaphore -------- */
+
+Semaphore::Semaphore(boost::asio::any_io_executor executor, size_t count)
+    : executor_(std::move(executor))
+    , count_(count) {}
+
+/* Если свободных слотов нет, корутина встаёт в очередь и ждёт на таймере.
+ * Освобождающий слот не увеличивает счётчик, а передаёт слот первому ожидающему,
+ * отменяя его таймер - так соблюдается порядок очереди */
+boost::asio::awaitable<Semaphore::Guard> Semaphore::Acquire() {
+    if (count_ > 0 && waiters_.empty()) {
+        --count_;
+        co_return Guard(this);
+    }
+    auto timer = std::make_shared<asio::steady_timer>(executor_, asio::steady_timer::time_point::max());
+    waiters_.push_back(timer);
+
+    boost::system::error_code ec;
+    co_await timer->async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    co_return Guard(this);
+}
+
+size_t Semaphore::Available() const noexcept {
+    return count_;
+}
+
+size_t Semaphore::Waiting() const noexcept {
+    return waiters_.size();
+}
+
+void Semaphore::Release() noexcept {
+    if (!waiters_.empty()) {
+        auto timer = std::move(waiters_.front());
+        waiters_.pop_front();
+        timer->cancel();
+    } else {
+        ++count_;
+    }
+}
+
+/* -------- Event -------- */
+
+Event::Event(boost::asio::any_io_executor executor)
+    : timer_(std::move(executor), asio::steady_timer::time_point::max()) {}
+
+boost::asio::awaitable<void> Event::Wait() {
+    if (is_set_) {
+        co_return;
+    }
+    boost::system::error_code ec;
+    co_await timer_.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+}
+
+void Event::Set() {
+    is_set_ = true;
+    timer_.cancel();
+}
+
+bool Event::IsSet() const noexcept {
+    return is_set_;
+}
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+/*
+ * Примитивы синхронизации корутин, выполняющихся в одном io_context
+ * Не потокобезопасны: все вызовы должны выполняться в потоке io_context
+ *
+ * Semaphore - ограничение количества одновременно выполняемых операций:
+ *** async_util::Semaphore sem(executor, 8);
+ *** auto guard = co_await sem.Acquire(); // слот освобождается при разрушении guard
+ *
+ * Event - событие, которого могут ждать несколько корутин:
+ *** co_await event.Wait(); // в другой корутине: event.Set();
+ *
+ * SingleFlight - объединение одновременных запросов с одинаковым ключом:
+ *** async_util::SingleFlight<std::string, Result> flights(executor);
+ *** Result res = co_await flights.Run(key, [&] { return Fetch(key); });
+ * пока выполняется запрос по ключу, остальные вызовы Run с тем же ключом ждут его результата
+ */
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace async_util {
+
+class Semaphore {
+public:
+    // Владение слотом семафора, слот возвращается при разрушении
+    class Guard {
+    public:
+        Guard() = default;
+        explicit Guard(Semaphore* sem) noexcept;
+        Guard(Guard&& other) noexcept;
+        Guard& operator=(Guard&& other) noexcept;
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard();
+
+        void Release() noexcept;
+
+    private:
+        Semaphore* sem_{nullptr};
+    };
+
+    Semaphore(boost::asio::any_io_executor executor, size_t count);
+
+    boost::asio::awaitable<Guard> Acquire();
+
+    size_t Available() const noexcept;
+    size_t Waiting() const noexcept;
+
+private:
+    void Release() noexcept;
+
+    boost::asio::any_io_executor executor_;
+    size_t count_;
+    std::deque<std::shared_ptr<boost::asio::steady_timer>> waiters_; // очередь ожидающих корутин (FIFO)
+};
+
+class Event {
+public:
+    explicit Event(boost::asio::any_io_executor executor);
+
+    boost::asio::awaitable<void> Wait();
+    void Set();
+    bool IsSet() const noexcept;
+
+private:
+    boost::asio::steady_timer timer_; // отмена таймера будит всех ожидающих
+    bool is_set_{false};
+};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class SingleFlight {
+public:
+    explicit SingleFlight(boost::asio::any_io_executor executor)
+        : executor_(std::move(executor)) {}
+
+    /* func - вызываемый объект без аргументов, возвращающий boost::asio::awaitable<Value>
+     * Исключение, выброшенное func, получают все ожидающие результата */
+    template <typename Func>
+    boost::asio::awaitable<Value> Run(Key key, Func func) {
+        if (auto it = flights_.find(key); it != flights_.end()) {
+            auto flight = it->second;
+            ++coalesced_;
+            co_await flight->done.Wait();
+            if (flight->error) {
+                std::rethrow_exception(flight->error);
+            }
+            co_return *flight->value;
+        }
+
+        auto flight = std::make_shared<Flight>(executor_);
+        flights_.emplace(key, flight);
+        ++executed_;
+        try {
+            flight->value.emplace(co_await func());
+        } catch (...) {
+            flight->error = std::current_exception();
+        }
+        flights_.erase(key);
+        flight->done.Set();
+        if (flight->error) {
+            std::rethrow_exception(flight->error);
+        }
+        co_return *flight->value;
+    }
+
+    uint64_t Executed() const noexcept {    // количество выполненных запросов
+        return executed_;
+    }
+    uint64_t Coalesced() const noexcept {   // количество вызовов, получивших результат чужого запроса
+        return coalesced_;
+    }
+    size_t InFlight() const noexcept {      // количество выполняющихся сейчас запросов
+        return flights_.size();
+    }
+
+private:
+    struct Flight {
+        explicit Flight(boost::asio::any_io_executor executor)
+            : done(std::move(executor)) {}
+
+        Event done;
+        std::optional<Value> value;
+        std::exception_ptr error;
+    };
+
+    boost::asio::any_io_executor executor_;
+    std::unordered_map<Key, std::shared_ptr<Flight>, Hash> flights_;
+    uint64_t executed_{};
+    uint64_t coalesced_{};
+};
+
+}
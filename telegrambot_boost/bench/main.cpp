@@ -0,0 +1,383 @@
+/*
+ * Микробенчмарки разбора ответов внешних сервисов и форматирования ответа пользователю
+ * - telega::util::ResponseProcess (getUpdates), meteo::util::ResponseProcess / ResponseProcessBatch (open-meteo),
+ *   geo::util::ResponseProcess (geocode) - вместе с json::parse и отдельно по разобранному JSON
+ * - meteo::util::ParseForecast - потоковый разбор open-meteo, как в боте
+ * - num_scan::DecodeFloatArray - разбор массива чисел прогноза в сравнении с json::parse
+ * - MeteoInfo::ToString, MeteoInfo::CachedReply (повторный ответ из кэша ответов), telega::Reply::Body
+ * Входные данные - записанные ответы сервисов в bench/payloads
+ * Для каждого бенчмарка выводится время (нс/операцию), количество и объём выделений памяти на операцию
+ * (подсчитываются заменой глобальных operator new/delete)
+ *
+ * Базовые значения хранятся в bench/baseline.txt: --save записывает текущие результаты (с --filter заменяются
+ * только значения выполненных бенчмарков, остальные сохраняются), при каждом запуске результаты сравниваются
+ * с базовыми. С --check программа завершается с ошибкой, если время выросло больше чем на max_regression процентов,
+ * выросло количество выделений или для бенчмарка нет базового значения
+ *
+ *** ./bench [--filter=meteo] [--min_time_ms=500] [--baseline=file] [--save] [--check] [--max_regression=10]
+ */
+#include "../geocode.h"
+#include "../meteobot.h"
+#include "../numscan.h"
+#include "../telegrambot.h"
+
+#include <boost/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifndef BENCH_DATA_DIR
+#define BENCH_DATA_DIR "."
+#endif
+
+/* -------- Подсчёт выделений памяти -------- */
+
+namespace {
+std::atomic<uint64_t> alloc_count{0};
+std::atomic<uint64_t> alloc_bytes{0};
+
+void* CountedAlloc(std::size_t size) noexcept {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+}
+
+void* operator new(std::size_t size) {
+    if (void* ptr = CountedAlloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+
+// Выровненные блоки (прогноз meteo::Forecast)
+void* operator new(std::size_t size, std::align_val_t align) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    const auto alignment = static_cast<std::size_t>(align);
+#ifdef _WIN32
+    if (void* ptr = _aligned_malloc(size ? size : 1, alignment)) {
+#else
+    if (void* ptr = std::aligned_alloc(alignment, ((size ? size : 1) + alignment - 1) / alignment * alignment)) {
+#endif
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void operator delete[](void* ptr, std::align_val_t align) noexcept {
+    operator delete(ptr, align);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t align) noexcept {
+    operator delete(ptr, align);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t align) noexcept {
+    operator delete(ptr, align);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+namespace json = boost::json;
+
+// Не даёт компилятору выбросить вычисление результата
+template <typename T>
+void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const void* volatile sink;
+    sink = &value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct Result {
+    double ns{};        // на операцию
+    double allocs{};
+    double bytes{};
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<void()> run;
+};
+
+/* Число повторов удваивается, пока замер не займёт min_time; выделения считаются по последнему замеру */
+Result Measure(const std::function<void()>& run, std::chrono::milliseconds min_time) {
+    using Clock = std::chrono::steady_clock;
+    for (int i = 0; i < 10; ++i) {
+        run();
+    }
+    for (uint64_t iterations = 16; ; iterations *= 2) {
+        const uint64_t count_before = alloc_count.load(std::memory_order_relaxed);
+        const uint64_t bytes_before = alloc_bytes.load(std::memory_order_relaxed);
+        const auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            run();
+        }
+        const auto elapsed = Clock::now() - start;
+        if (elapsed >= min_time) {
+            const auto n = static_cast<double>(iterations);
+            return {.ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / n,
+                    .allocs = static_cast<double>(alloc_count.load(std::memory_order_relaxed) - count_before) / n,
+                    .bytes = static_cast<double>(alloc_bytes.load(std::memory_order_relaxed) - bytes_before) / n};
+        }
+    }
+}
+
+std::string ReadPayload(const std::string& name) {
+    const auto path = std::filesystem::path(BENCH_DATA_DIR) / "payloads" / name;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error(std::format("Cannot open {}", path.string()));
+    }
+    std::ostringstream data;
+    data << in.rdbuf();
+    return data.str();
+}
+
+// Формат файла: строки "имя нс/операцию выделений/операцию байт/операцию", # - комментарий
+std::map<std::string, Result> LoadBaseline(const std::string& file_name) {
+    std::map<std::string, Result> baseline;
+    std::ifstream in(file_name);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name;
+        Result result;
+        if (fields >> name >> result.ns >> result.allocs >> result.bytes) {
+            baseline[name] = result;
+        }
+    }
+    return baseline;
+}
+
+void SaveBaseline(const std::string& file_name, const std::map<std::string, Result>& results) {
+    std::ofstream out(file_name, std::ios::trunc);
+    out << "# name ns/op allocs/op bytes/op\n";
+    out << "# Базовые значения записываются командой ./bench --save на эталонной машине\n";
+    for (const auto& [name, result] : results) {
+        out << std::format("{} {:.1f} {:.2f} {:.1f}\n", name, result.ns, result.allocs, result.bytes);
+    }
+}
+
+std::string Delta(double current, double base) {
+    if (base <= 0) {
+        return current > 0 ? "new" : "=";
+    }
+    return std::format("{:+.1f}%", (current - base) / base * 100);
+}
+
+std::vector<Benchmark> MakeBenchmarks() {
+    std::vector<Benchmark> benchmarks;
+
+    const std::string updates = ReadPayload("getupdates_100.json");
+    const json::object updates_obj = json::parse(updates).as_object();
+    benchmarks.push_back({"telegram/getUpdates_100/parse+process", [updates] {
+        DoNotOptimize(telega::util::ResponseProcess(json::parse(updates).as_object()));
+    }});
+    benchmarks.push_back({"telegram/getUpdates_100/process", [updates_obj] {
+        DoNotOptimize(telega::util::ResponseProcess(updates_obj));
+    }});
+
+    for (const std::string name : {"forecast_2d", "forecast_16d", "forecast_batch50_2d"}) {
+        const std::string forecast = ReadPayload(name + ".json");
+        benchmarks.push_back({"meteo/" + name + "/parse+process", [forecast] {
+            DoNotOptimize(meteo::util::ResponseProcessBatch(json::parse(forecast)));
+        }});
+        benchmarks.push_back({"meteo/" + name + "/stream", [forecast] {
+            DoNotOptimize(meteo::util::ParseForecast(forecast));
+        }});
+        const json::value forecast_value = json::parse(forecast);
+        if (forecast_value.is_object()) {
+            benchmarks.push_back({"meteo/" + name + "/process", [forecast_obj = forecast_value.as_object()] {
+                DoNotOptimize(meteo::util::ResponseProcess(forecast_obj));
+            }});
+        }
+    }
+
+    /* Массив temperature_2m прогноза на 16 дней: разбор json::parse с as_double (как до num_scan),
+     * num_scan без векторных инструкций и с ними */
+    const std::string forecast_16d = ReadPayload("forecast_16d.json");
+    const size_t array_begin = forecast_16d.find("[", forecast_16d.find("\"temperature_2m\":["));
+    const std::string temperature = forecast_16d.substr(array_begin, forecast_16d.find(']', array_begin) + 1 - array_begin);
+    benchmarks.push_back({"numscan/temperature_16d/json", [temperature] {
+        std::vector<float> values;
+        for (const auto& val : json::parse(temperature).as_array()) {
+            values.push_back(static_cast<float>(val.as_double()));
+        }
+        DoNotOptimize(values);
+    }});
+    benchmarks.push_back({"numscan/temperature_16d/scalar", [temperature] {
+        std::vector<float> values;
+        DoNotOptimize(num_scan::DecodeFloatArrayScalar(temperature.data(), temperature.data() + temperature.size(), values));
+        DoNotOptimize(values);
+    }});
+    benchmarks.push_back({std::format("numscan/temperature_16d/{}", num_scan::Isa()), [temperature] {
+        std::vector<float> values;
+        DoNotOptimize(num_scan::DecodeFloatArray(temperature.data(), temperature.data() + temperature.size(), values));
+        DoNotOptimize(values);
+    }});
+
+    for (const std::string name : {"geocode_found", "geocode_not_found"}) {
+        const std::string geocode = ReadPayload(name + ".json");
+        benchmarks.push_back({"geo/" + name + "/parse+process", [geocode] {
+            DoNotOptimize(geo::util::ResponseProcess(json::parse(geocode)));
+        }});
+        benchmarks.push_back({"geo/" + name + "/process", [geocode_value = json::parse(geocode)] {
+            DoNotOptimize(geo::util::ResponseProcess(geocode_value));
+        }});
+    }
+
+    const meteo::MeteoInfo info = meteo::util::ResponseProcess(json::parse(ReadPayload("forecast_2d.json")).as_object());
+    // момент внутри записанного прогноза
+    const meteo::TimePoint now{std::chrono::seconds{info.forecast.Start() + 14 * 3600}};
+    benchmarks.push_back({"meteo/ToString", [info, now] {
+        DoNotOptimize(info.ToString("Россия, Республика Татарстан, Казань", now));
+    }});
+    benchmarks.push_back({"meteo/CachedReply", [info, now]() mutable {
+        DoNotOptimize(info.CachedReply("Россия, Республика Татарстан, Казань", now));
+    }});
+    benchmarks.push_back({"telegram/Reply::Body", [reply = telega::MakeReply(info.ToString("Казань", now))] {
+        DoNotOptimize(reply->Body("123456789", "sendMessage"));
+    }});
+    return benchmarks;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::string baseline_file = (std::filesystem::path(BENCH_DATA_DIR) / "baseline.txt").string();
+    std::chrono::milliseconds min_time{500};
+    double max_regression{10.0};
+    bool save{false};
+    bool check{false};
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg(argv[i]);
+            const size_t eq = arg.find('=');
+            const std::string_view name = arg.substr(0, eq);
+            const std::string value(eq == std::string_view::npos ? std::string_view{} : arg.substr(eq + 1));
+            if (name == "--filter") {
+                filter = value;
+            } else if (name == "--baseline") {
+                baseline_file = value;
+            } else if (name == "--min_time_ms") {
+                min_time = std::chrono::milliseconds{std::stoll(value)};
+            } else if (name == "--max_regression") {
+                max_regression = std::stod(value);
+            } else if (name == "--save") {
+                save = true;
+            } else if (name == "--check") {
+                check = true;
+            } else {
+                throw std::invalid_argument(std::format("Unknown option: {}", arg));
+            }
+        }
+
+        const auto baseline = LoadBaseline(baseline_file);
+        auto results = baseline; // --save с --filter не должен терять значения невыполненных бенчмарков
+        bool regressed{false};
+        std::vector<std::string> missing;   // бенчмарки без базового значения
+        std::cout << std::format("{:<42} {:>12} {:>10} {:>12}   {:>8} {:>8}\n",
+                                 "benchmark", "ns/op", "allocs/op", "bytes/op", "time", "allocs");
+        for (const auto& benchmark : MakeBenchmarks()) {
+            if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+                continue;
+            }
+            const Result result = Measure(benchmark.run, min_time);
+            std::string comparison;
+            if (auto it = baseline.find(benchmark.name); it != baseline.end()) {
+                const Result& base = it->second;
+                comparison = std::format("   {:>8} {:>8}", Delta(result.ns, base.ns), Delta(result.allocs, base.allocs));
+                if (result.ns > base.ns * (1 + max_regression / 100) || result.allocs > base.allocs + 0.5) {
+                    regressed = true;
+                    comparison += "  REGRESSION";
+                }
+            } else {
+                // без базового значения регрессию не обнаружить, --check не должен проходить молча
+                regressed = true;
+                comparison = "   NO BASELINE";
+                missing.push_back(benchmark.name);
+            }
+            std::cout << std::format("{:<42} {:>12.1f} {:>10.2f} {:>12.1f}{}\n",
+                                     benchmark.name, result.ns, result.allocs, result.bytes, comparison);
+            results[benchmark.name] = result;
+        }
+        if (save) {
+            SaveBaseline(baseline_file, results);
+            std::cout << std::format("Baseline saved to {}\n", baseline_file);
+        } else if (!missing.empty()) {
+            std::cout << std::format("\n{} benchmark(s) without baseline, record them with:\n", missing.size());
+            for (const auto& name : missing) {
+                std::cout << std::format("  ./bench --save --filter={}\n", name);
+            }
+        }
+        return check && regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << "\n";
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,155 @@
+#include "fileutil.h"
+#include "logger.h"
+
+#include <charconv>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <system_error>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace file_util {
+
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+
+/* В Windows сброс на диск не выполняется, rename заменяет существующий файл (MoveFileEx) */
+void WriteFileAtomic(const std::string& file_name, std::string_view data, [[maybe_unused]] bool sync) {
+    const std::string tmp_name = file_name + ".tmp";
+    {
+        std::ofstream out(tmp_name, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        out.close();
+        if (!out) {
+            throw std::runtime_error(std::format("Failed to write {}", tmp_name));
+        }
+    }
+    fs::rename(tmp_name, file_name);
+}
+
+#else
+
+namespace {
+
+[[noreturn]] void ThrowErrno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Закрывает дескриптор при выходе из области видимости (в том числе по исключению)
+struct FdGuard {
+    ~FdGuard() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    int fd;
+};
+
+}
+
+/* После rename сбрасывается и каталог, иначе при сбое питания запись о новом имени может потеряться */
+void WriteFileAtomic(const std::string& file_name, std::string_view data, bool sync) {
+    const std::string tmp_name = file_name + ".tmp";
+    {
+        FdGuard file{::open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+        if (file.fd < 0) {
+            ThrowErrno("open " + tmp_name);
+        }
+        while (!data.empty()) {
+            const ssize_t written = ::write(file.fd, data.data(), data.size());
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ThrowErrno("write " + tmp_name);
+            }
+            data.remove_prefix(static_cast<size_t>(written));
+        }
+        if (sync && ::fsync(file.fd) != 0) {
+            ThrowErrno("fsync " + tmp_name);
+        }
+    }
+    if (::rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+        ThrowErrno("rename " + tmp_name);
+    }
+    if (sync) {
+        std::string dir = fs::path(file_name).parent_path().string();
+        FdGuard dir_fd{::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+        if (dir_fd.fd >= 0) {
+            ::fsync(dir_fd.fd);
+        }
+    }
+}
+
+#endif
+
+/* -------- Checkpoint -------- */
+
+Checkpoint::Checkpoint(std::string file_name)
+    : file_name_(std::move(file_name))
+    , writer_([this] { WriteLoop(); }) {}
+
+Checkpoint::~Checkpoint() {
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    changed_.notify_one();
+    writer_.join();
+}
+
+// Значение хранится текстом, чтобы его можно было посмотреть и при необходимости исправить вручную
+std::optional<int64_t> Checkpoint::Load(const std::string& file_name) {
+    std::ifstream in(file_name);
+    std::string text;
+    if (!in || !std::getline(in, text)) {
+        return std::nullopt;
+    }
+    int64_t value{};
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+void Checkpoint::Save(int64_t value) {
+    {
+        std::lock_guard lock(mutex_);
+        pending_ = value;
+    }
+    changed_.notify_one();
+}
+
+uint64_t Checkpoint::Writes() const {
+    std::lock_guard lock(mutex_);
+    return writes_;
+}
+
+void Checkpoint::WriteLoop() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        changed_.wait(lock, [this] { return stop_ || pending_; });
+        if (!pending_) {
+            return;
+        }
+        const int64_t value = *pending_;
+        pending_.reset();
+        lock.unlock();
+        try {
+            WriteFileAtomic(file_name_, std::to_string(value) + "\n");
+        } catch (const std::exception& err) {
+            logger::LogError(err.what(), "Checkpoint::WriteLoop");
+        }
+        lock.lock();
+        ++writes_;
+    }
+}
+
+}
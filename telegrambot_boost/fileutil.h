@@ -0,0 +1,131 @@
+#pragma once
+/*
+ * Работа с файлами состояния
+ * - атомарная запись: данные пишутся во временный файл рядом с целевым, сбрасываются на диск
+ *   и временный файл переименовывается в целевой. При сбое остаётся либо старый, либо новый файл целиком
+ * - последовательная запись и чтение двоичных данных (числа little-endian как в памяти, строки с длиной)
+ * - контрольная точка монотонно растущего значения (например, смещения getUpdates) с записью в фоновом потоке
+ *
+ * Использование:
+ *** file_util::BinaryWriter writer;
+ *** writer.Put<uint32_t>(count);
+ *** writer.PutString(name);
+ *** file_util::WriteFileAtomic("state.bin", writer.Data());
+ */
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+namespace file_util {
+
+// бросает исключение при ошибке записи, sync = false - без сброса на диск (быстрее, но не переживает сбой питания)
+void WriteFileAtomic(const std::string& file_name, std::string_view data, bool sync = true);
+
+class BinaryWriter {
+public:
+    template <typename T>
+    void Put(T value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        data_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void PutString(std::string_view value) {
+        Put<uint32_t>(static_cast<uint32_t>(value.size()));
+        data_.append(value);
+    }
+
+    // Без длины: размер при чтении известен заранее
+    void PutBytes(std::string_view value) {
+        data_.append(value);
+    }
+
+    std::string_view Data() const noexcept {
+        return data_;
+    }
+
+private:
+    std::string data_;
+};
+
+// Чтение из буфера (например, отображённого в память файла), при выходе за границы бросает исключение
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data) : data_(data) {}
+
+    template <typename T>
+    T Get() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, Take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view GetString() {
+        return Take(Get<uint32_t>());
+    }
+
+    std::string_view GetBytes(size_t size) {
+        return Take(size);
+    }
+
+    bool AtEnd() const noexcept {
+        return pos_ == data_.size();
+    }
+
+    size_t Remaining() const noexcept {
+        return data_.size() - pos_;
+    }
+
+private:
+    std::string_view Take(size_t size) {
+        if (data_.size() - pos_ < size) {
+            throw std::out_of_range("Unexpected end of binary data");
+        }
+        std::string_view result = data_.substr(pos_, size);
+        pos_ += size;
+        return result;
+    }
+
+    std::string_view data_;
+    size_t pos_{0};
+};
+
+/* Контрольная точка: Save только запоминает значение, запись выполняет фоновый поток
+ * Пока идёт запись (с fsync), новые значения накапливаются, и следующая запись сохраняет последнее из них,
+ * поэтому количество сбросов на диск не зависит от частоты Save.
+ * Деструктор дожидается записи последнего сохранённого значения */
+class Checkpoint {
+public:
+    explicit Checkpoint(std::string file_name);
+    ~Checkpoint();
+
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+
+    // nullopt - файла нет или он повреждён
+    static std::optional<int64_t> Load(const std::string& file_name);
+
+    void Save(int64_t value);
+    uint64_t Writes() const;
+
+private:
+    void WriteLoop();
+
+    std::string file_name_;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::optional<int64_t> pending_;    // значение, ожидающее записи
+    uint64_t writes_{};
+    bool stop_{false};
+    std::thread writer_;
+};
+
+}
@@ -0,0 +1,154 @@
+#include "gazetteer.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace gazetteer {
+
+namespace bip = boost::interprocess;
+
+/* -------- Gazetteer -------- */
+
+/* Файл отображается в память только для чтения, таблицы используются на месте
+ * Перед использованием проверяем, что все таблицы и строки лежат внутри файла,
+ * чтобы повреждённый файл не приводил к чтению за пределами отображения */
+Gazetteer::Gazetteer(const std::string& file_name)
+    : file_(file_name.c_str(), bip::read_only)
+    , region_(file_, bip::read_only) {
+    const auto* data = static_cast<const char*>(region_.get_address());
+    const size_t size = region_.get_size();
+
+    if (size < sizeof(FileHeader)) {
+        throw std::runtime_error(std::format("Gazetteer file {} is too small", file_name));
+    }
+    header_ = reinterpret_cast<const FileHeader*>(data);
+    if (header_->magic != MAGIC || header_->version != VERSION) {
+        throw std::runtime_error(std::format("Gazetteer file {} has unknown format", file_name));
+    }
+    const uint64_t tables_size = sizeof(FileHeader) +
+                                 uint64_t{header_->entry_count} * sizeof(Entry) +
+                                 uint64_t{header_->place_count} * sizeof(Place);
+    if (tables_size + header_->strings_size != size) {
+        throw std::runtime_error(std::format("Gazetteer file {} is truncated", file_name));
+    }
+    entries_ = reinterpret_cast<const Entry*>(data + sizeof(FileHeader));
+    places_ = reinterpret_cast<const Place*>(entries_ + header_->entry_count);
+    strings_ = reinterpret_cast<const char*>(places_ + header_->place_count);
+
+    for (uint32_t i = 0; i < header_->entry_count; ++i) {
+        const Entry& entry = entries_[i];
+        if (entry.place >= header_->place_count ||
+            uint64_t{entry.name_offset} + entry.name_size > header_->strings_size) {
+            throw std::runtime_error(std::format("Gazetteer file {} has invalid entry {}", file_name, i));
+        }
+    }
+    for (uint32_t i = 0; i < header_->place_count; ++i) {
+        const Place& place = places_[i];
+        if (uint64_t{place.address_offset} + place.address_size > header_->strings_size) {
+            throw std::runtime_error(std::format("Gazetteer file {} has invalid place {}", file_name, i));
+        }
+    }
+}
+
+std::string_view Gazetteer::String(uint32_t offset, uint32_t size) const noexcept {
+    return {strings_ + offset, size};
+}
+
+// name должен быть нормализован так же, как названия при сборке справочника
+std::optional<PlaceInfo> Gazetteer::Find(std::string_view name) const {
+    const Entry* end = entries_ + header_->entry_count;
+    const Entry* it = std::lower_bound(entries_, end, name, [this](const Entry& entry, std::string_view value) {
+        return String(entry.name_offset, entry.name_size) < value;
+    });
+    if (it == end || String(it->name_offset, it->name_size) != name) {
+        return std::nullopt;
+    }
+    const Place& place = places_[it->place];
+    return PlaceInfo{.latitude = place.latitude,
+                     .longitude = place.longitude,
+                     .address = std::string(String(place.address_offset, place.address_size))};
+}
+
+size_t Gazetteer::Names() const noexcept {
+    return header_->entry_count;
+}
+
+size_t Gazetteer::Places() const noexcept {
+    return header_->place_count;
+}
+
+/* -------- Builder -------- */
+
+uint32_t Builder::AddPlace(double latitude, double longitude, std::string_view address) {
+    if (places_.size() >= std::numeric_limits<uint32_t>::max() ||
+        strings_.size() + address.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Gazetteer is too large");
+    }
+    places_.push_back({.latitude = latitude,
+                       .longitude = longitude,
+                       .address_offset = static_cast<uint32_t>(strings_.size()),
+                       .address_size = static_cast<uint32_t>(address.size())});
+    strings_.append(address);
+    return static_cast<uint32_t>(places_.size() - 1);
+}
+
+void Builder::AddName(std::string_view name, uint32_t place) {
+    if (place >= places_.size()) {
+        throw std::out_of_range(std::format("Unknown place {}", place));
+    }
+    if (!name.empty()) {
+        names_.push_back({std::string(name), place});
+    }
+}
+
+/* Названия сортируются по байтам (как сравнивает std::string_view при поиске),
+ * повторяющиеся названия удаляются. Строки названий дописываются после описаний городов */
+void Builder::Write(const std::string& file_name) const {
+    std::vector<NameRecord> names = names_;
+    std::stable_sort(names.begin(), names.end(), [](const NameRecord& lhs, const NameRecord& rhs) {
+        return lhs.name < rhs.name;
+    });
+    names.erase(std::unique(names.begin(), names.end(), [](const NameRecord& lhs, const NameRecord& rhs) {
+        return lhs.name == rhs.name;
+    }), names.end());
+
+    std::string strings = strings_;
+    std::vector<Entry> entries;
+    entries.reserve(names.size());
+    for (const auto& record : names) {
+        if (strings.size() + record.name.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("Gazetteer is too large");
+        }
+        entries.push_back({.name_offset = static_cast<uint32_t>(strings.size()),
+                           .name_size = static_cast<uint32_t>(record.name.size()),
+                           .place = record.place});
+        strings.append(record.name);
+    }
+
+    const FileHeader header{.entry_count = static_cast<uint32_t>(entries.size()),
+                            .place_count = static_cast<uint32_t>(places_.size()),
+                            .strings_size = strings.size()};
+
+    std::ofstream out(file_name, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+    out.write(reinterpret_cast<const char*>(places_.data()), places_.size() * sizeof(Place));
+    out.write(strings.data(), strings.size());
+    out.close();
+    if (!out) {
+        throw std::runtime_error(std::format("Failed to write gazetteer file {}", file_name));
+    }
+}
+
+size_t Builder::Names() const noexcept {
+    return names_.size();
+}
+
+size_t Builder::Places() const noexcept {
+    return places_.size();
+}
+
+}
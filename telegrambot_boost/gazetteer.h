@@ -0,0 +1,108 @@
+#pragma once
+/*
+ * Локальный справочник городов (газеттир) для поиска координат без запроса к geocode
+ * Файл справочника отображается в память целиком и не копируется, поиск - двоичный по нормализованному названию
+ * Одному городу может соответствовать несколько названий (кириллица, транслитерация, с регионом и без)
+ * Файл собирается утилитой gazetteer_build из CSV (см. Readme.md)
+ *
+ * Формат файла (все числа little-endian):
+ * - FileHeader
+ * - Entry[entry_count]  - названия, отсортированы по байтам названия
+ * - Place[place_count]  - координаты и описание городов
+ * - строки названий и описаний (без завершающих нулей)
+ *
+ * Использование:
+ *** gazetteer::Gazetteer gazetteer("gazetteer.bin");
+ *** if (auto place = gazetteer.Find("москва")) { place->latitude ... }
+ */
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gazetteer {
+
+constexpr uint32_t MAGIC{0x525A4147};  // "GAZR"
+constexpr uint32_t VERSION{1};
+
+#pragma pack(push, 1)
+struct FileHeader {
+    uint32_t magic{MAGIC};
+    uint32_t version{VERSION};
+    uint32_t entry_count{};
+    uint32_t place_count{};
+    uint64_t strings_size{};
+};
+
+struct Entry {
+    uint32_t name_offset{};   // смещение названия от начала блока строк
+    uint32_t name_size{};
+    uint32_t place{};         // индекс в массиве Place
+};
+
+struct Place {
+    double latitude{};
+    double longitude{};
+    uint32_t address_offset{};
+    uint32_t address_size{};
+};
+#pragma pack(pop)
+
+struct PlaceInfo {
+    double latitude{};
+    double longitude{};
+    std::string address{};
+};
+
+class Gazetteer {
+public:
+    // бросает исключение, если файл не удалось открыть или его формат неверен
+    explicit Gazetteer(const std::string& file_name);
+
+    std::optional<PlaceInfo> Find(std::string_view name) const;
+
+    size_t Names() const noexcept;
+    size_t Places() const noexcept;
+
+private:
+    std::string_view String(uint32_t offset, uint32_t size) const noexcept;
+
+    boost::interprocess::file_mapping file_;
+    boost::interprocess::mapped_region region_;
+    const FileHeader* header_{nullptr};
+    const Entry* entries_{nullptr};
+    const Place* places_{nullptr};
+    const char* strings_{nullptr};
+};
+
+/* Сборка файла справочника. Названия могут повторяться только для одного и того же города,
+ * при повторе названия для разных городов остаётся первый */
+class Builder {
+public:
+    // возвращает индекс города для AddName
+    uint32_t AddPlace(double latitude, double longitude, std::string_view address);
+    void AddName(std::string_view name, uint32_t place);
+
+    // бросает исключение при ошибке записи
+    void Write(const std::string& file_name) const;
+
+    size_t Names() const noexcept;
+    size_t Places() const noexcept;
+
+private:
+    struct NameRecord {
+        std::string name;
+        uint32_t place;
+    };
+
+    std::vector<NameRecord> names_;
+    std::vector<Place> places_;
+    std::string strings_;
+};
+
+}
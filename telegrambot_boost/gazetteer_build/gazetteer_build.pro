@@ -0,0 +1,17 @@
+TEMPLATE = app
+CONFIG -= qt
+CONFIG += console c++20
+CONFIG += static
+
+win32: {
+    INCLUDEPATH += "C:/boost"
+}
+
+SOURCES += \
+    ../gazetteer.cpp \
+    ../normalize.cpp \
+    main.cpp
+
+HEADERS += \
+    ../gazetteer.h \
+    ../normalize.h
@@ -0,0 +1,120 @@
+/*
+ * Сборка файла локального справочника городов из CSV
+ * gazetteer_build <входной CSV> <выходной файл>
+ *
+ * Формат строки CSV (разделитель - запятая, поля с запятыми заключаются в двойные кавычки):
+ *** название,широта,долгота,описание,псевдонимы
+ * псевдонимы (английское название, сокращения и т.п.) разделяются символом '|', поле может быть пустым
+ * Строки, у которых широта не является числом (например, заголовок), пропускаются
+ *
+ * Названия приводятся к тому же ключу, по которому их ищет бот (normalize::Normalizer::Key)
+ */
+#include "../gazetteer.h"
+#include "../normalize.h"
+
+#include <boost/algorithm/string.hpp>
+#include <charconv>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Разбор строки CSV: поля в кавычках могут содержать запятые, "" внутри кавычек - одна кавычка
+std::vector<std::string> SplitCsv(std::string_view line) {
+    std::vector<std::string> fields(1);
+    bool quoted{false};
+    for (size_t i = 0; i < line.size(); ++i) {
+        const char ch = line[i];
+        if (quoted) {
+            if (ch == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                fields.back() += '"';
+                ++i;
+            } else if (ch == '"') {
+                quoted = false;
+            } else {
+                fields.back() += ch;
+            }
+        } else if (ch == '"') {
+            quoted = true;
+        } else if (ch == ',') {
+            fields.emplace_back();
+        } else if (ch != '\r') {
+            fields.back() += ch;
+        }
+    }
+    return fields;
+}
+
+std::optional<double> ToDouble(std::string_view text) {
+    double value{};
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || ec != std::errc{} || ptr != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: gazetteer_build <input.csv> <output.bin>\n";
+        return 1;
+    }
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "Failed to open " << argv[1] << '\n';
+        return 1;
+    }
+
+    const normalize::Normalizer normalizer;
+    gazetteer::Builder builder;
+    std::string line;
+    size_t line_no{0};
+    size_t skipped{0};
+    try {
+        while (std::getline(in, line)) {
+            ++line_no;
+            auto fields = SplitCsv(line);
+            if (fields.size() < 4) {
+                ++skipped;
+                continue;
+            }
+            for (auto& field : fields) {
+                boost::algorithm::trim(field);
+            }
+            const auto latitude = ToDouble(fields[1]);
+            const auto longitude = ToDouble(fields[2]);
+            if (!latitude || !longitude) {
+                if (line_no > 1) {
+                    std::cerr << "Line " << line_no << ": invalid coordinates, skipped\n";
+                }
+                ++skipped;
+                continue;
+            }
+
+            const uint32_t place = builder.AddPlace(*latitude, *longitude, fields[3]);
+            builder.AddName(normalizer.Key(fields[0]), place);
+            if (fields.size() > 4) {
+                std::vector<std::string> aliases;
+                boost::algorithm::split(aliases, fields[4], boost::algorithm::is_any_of("|"));
+                for (const auto& alias : aliases) {
+                    builder.AddName(normalizer.Key(alias), place);
+                }
+            }
+        }
+        builder.Write(argv[2]);
+    } catch (const std::exception& err) {
+        std::cerr << "Error: " << err.what() << '\n';
+        return 1;
+    }
+
+    std::cout << "Places: " << builder.Places() << ", names: " << builder.Names()
+              << ", skipped lines: " << skipped << '\n';
+    return 0;
+}
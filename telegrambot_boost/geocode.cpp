@@ -1,8 +1,12 @@
 #include "logger.h"
 #include "geocode.h"
+#include "metrics.h"
 
+#include <boost/url/encode.hpp>
+#include <boost/url/rfc/pchars.hpp>
 #include <format>
 #include <string>
+#include <utility>
 
 
 namespace geo {
@@ -11,6 +15,30 @@ namespace beast = boost::beast;
 namespace http = beast::http;
 namespace json = boost::json;
 
+namespace {
+
+// Откуда получен ответ и время запроса к серверу (включая ожидание подключения из пула)
+struct GeocodeMetrics {
+    metrics::Counter& gazetteer;
+    metrics::Counter& not_found;
+    metrics::Counter& upstream;
+    metrics::Histogram& upstream_latency;
+};
+
+const GeocodeMetrics& Metrics() {
+    constexpr static char LOOKUPS[]{"bot_geocode_lookups_total"};
+    auto& registry = metrics::Global();
+    static const GeocodeMetrics geocode_metrics{
+        registry.GetCounter(LOOKUPS, R"(source="gazetteer")", "Town lookups by answer source"),
+        registry.GetCounter(LOOKUPS, R"(source="negative_cache")"),
+        registry.GetCounter(LOOKUPS, R"(source="upstream")"),
+        registry.GetHistogram("bot_geocode_upstream_seconds", "", "Geocoder request latency including pool wait")
+    };
+    return geocode_metrics;
+}
+
+}
+
 namespace util {
 
 /* Разбор геоданных.
@@ -56,35 +84,74 @@ std::optional<GeoInfo> ResponseProcess(const json::value& msg) {
 
 }
 
-Geocode::Geocode(boost::asio::io_context& ioc)
-    : client_(std::make_unique<https_sync::HttpsSyncClient>(ioc)) {}
+Geocode::Geocode(std::shared_ptr<https_pool::HttpsPool> pool,
+                 std::shared_ptr<const gazetteer::Gazetteer> gazetteer,
+                 cache::CacheSettings not_found_settings)
+    : pool_(std::move(pool))
+    , gazetteer_(std::move(gazetteer))
+    , not_found_(not_found_settings, [](const std::string& town, bool) {
+        return town.capacity();
+    }) {}
+
+cache::CacheStats Geocode::GetNotFoundStats() const noexcept {
+    return not_found_.GetStats();
+}
 
-/* запрос GET в API geocode-maps.yandex.ru должен быть URL-encoded
- * !!! town должен быть URL encoded */
-std::optional<GeoInfo> Geocode::GetPosition(const std::string& town) const {
+uint64_t Geocode::LocalHits() const noexcept {
+    return local_hits_;
+}
+
+/* Сначала название ищется по ключу в локальном справочнике, затем query запрашивается в geocode-maps.yandex.ru
+ * запрос GET в API geocode-maps.yandex.ru должен быть URL-encoded
+ * Запрос выполняется на подключении из общего пула
+ * Если сервер ответил, что город не найден, название запоминается в отрицательном кэше.
+ * Ошибки запроса в кэш не попадают, такое название будет запрошено снова */
+boost::asio::awaitable<std::optional<GeoInfo>> Geocode::GetPosition(const std::string& key, const std::string& query,
+                                                                    tracing::TracePtr trace) {
     const int http_version{11};
 
+    tracing::Span span(trace, "geocode");
+    if (gazetteer_) {
+        if (auto place = gazetteer_->Find(key)) {
+            ++local_hits_;
+            Metrics().gazetteer.Inc();
+            span.Arg("source", "gazetteer");
+            co_return GeoInfo{.latitude = place->latitude,
+                              .longitude = place->longitude,
+                              .address = std::move(place->address)};
+        }
+    }
+    if (not_found_.Get(key)) {
+        Metrics().not_found.Inc();
+        span.Arg("source", "negative_cache");
+        co_return std::nullopt;
+    }
+    Metrics().upstream.Inc();
+    span.Arg("source", "upstream");
+    metrics::ScopedTimer timer(Metrics().upstream_latency);
     try {
-        client_->Connect(HOST);
         // Ищем только один город
         std::string target = std::format("/v1/?apikey={}"
                                          "&geocode={}&lang=ru_RU&results=1&format=json",
-                                         API_KEY, town);
+                                         API_KEY, boost::urls::encode(query, boost::urls::pchars));
         http::request<http::string_body> req{http::verb::get,
                                              target,
                                              http_version};
         req.set(http::field::host, HOST);
 
-        std::string answer = client_->Exchange(std::move(req));
+        std::string answer = co_await pool_->Exchange(HOST, std::move(req));
         if (!answer.empty()) {
-            return util::ResponseProcess(json::parse(answer));
+            auto town_info = util::ResponseProcess(json::parse(answer));
+            if (!town_info) {
+                not_found_.Put(key, true);
+            }
+            co_return town_info;
         }
-        client_->Disconnect();
     } catch (const std::exception& err) {
-        logger::LogError(err.what(), "Geocode::GetPosition");
-        return std::nullopt;
+        LOG_LIMITED(logger::Level::error, 10, err.what(), "Geocode::GetPosition");
+        co_return std::nullopt;
     }
-    return std::nullopt;
+    co_return std::nullopt;
 }
 
 }
@@ -2,11 +2,20 @@
 /*
  * Получение координат и текстового описания города по названию
  * Используется API geocode-maps.yandex.ru
+ * Названия, для которых город не найден, запоминаются в отрицательном кэше на время ttl,
+ * повторные запросы таких названий не отправляются на сервер
+ * Если задан локальный справочник городов (gazetteer), название сначала ищется в нём,
+ * а geocode-maps.yandex.ru запрашивается только для названий, которых нет в справочнике
  */
-#include "httpssyncclient.h"
+#include "gazetteer.h"
+#include "httpspool.h"
+#include "lrucache.h"
+#include "tracing.h"
 
+#include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <boost/json.hpp>
+#include <chrono>
 #include <memory>
 #include <optional>
 #include <string>
@@ -23,12 +32,24 @@ class Geocode {
     constexpr static char API_KEY[]{"Here_must_be_Your_api_key"};
     constexpr static char HOST[]{"geocode-maps.yandex.ru"};
 public:
-    Geocode(boost::asio::io_context& ioc);
+    explicit Geocode(std::shared_ptr<https_pool::HttpsPool> pool,
+                     std::shared_ptr<const gazetteer::Gazetteer> gazetteer = nullptr,
+                     cache::CacheSettings not_found_settings = {.max_entries = 10000,
+                                                                .max_bytes = 4 * 1024 * 1024,
+                                                                .ttl = std::chrono::hours{6}});
 
-    std::optional<GeoInfo> GetPosition(const std::string& town) const;
+    // key - нормализованное название (ключ справочника и отрицательного кэша), query - название для запроса к серверу
+    boost::asio::awaitable<std::optional<GeoInfo>> GetPosition(const std::string& key, const std::string& query,
+                                                               tracing::TracePtr trace = nullptr);
+
+    cache::CacheStats GetNotFoundStats() const noexcept; // hits - запросы, не отправленные на сервер
+    uint64_t LocalHits() const noexcept;                 // названия, найденные в локальном справочнике
 
 private:
-    std::unique_ptr<https_sync::HttpsSyncClient> client_;
+    std::shared_ptr<https_pool::HttpsPool> pool_;
+    std::shared_ptr<const gazetteer::Gazetteer> gazetteer_;
+    uint64_t local_hits_{};
+    cache::LruCache<std::string, bool> not_found_; // отрицательный кэш: названия, для которых город не найден
 };
 
 namespace util {
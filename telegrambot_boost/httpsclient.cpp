@@ -1,8 +1,10 @@
 #include "logger.h"
 #include "httpsclient.h"
+#include "metrics.h"
 
 #include <chrono>
 #include <sstream>
+#include <utility>
 
 namespace https_client {
 
@@ -18,47 +20,88 @@ void CheckSSLShutdownError(boost::system::error_code ec) {
     if (ec == asio::ssl::error::stream_truncated) {
         ec.assign(0, ec.category());
     } else if (ec) {
-        logger::LogError(std::string("Ошибка при выключении: ") + ec.to_string(), "HttpsClient");
+        LOG_LIMITED(logger::Level::warn, 10, std::string("Ошибка при выключении: ") + ec.to_string(), "HttpsClient");
     }
 }
 
 }
 
-HttpsClient::HttpsClient(boost::asio::any_io_executor& executor)
-    : executor_(executor) {}
+HttpsClient::HttpsClient(boost::asio::any_io_executor& executor,
+                         std::shared_ptr<boost::asio::ssl::context> ssl_ctx)
+    : executor_(executor)
+    , shared_ctx_(ssl_ctx != nullptr)
+    , ssl_ctx_(std::move(ssl_ctx)) {}
 
 HttpsClient::~HttpsClient() {
+    if (!stream_) {
+        return;
+    }
     boost::system::error_code ec;
     stream_->shutdown(ec);
     CheckSSLShutdownError(ec);
 }
 
-boost::asio::awaitable<void> HttpsClient::Connect(const std::string& host) {
+boost::asio::awaitable<void> HttpsClient::Connect(const std::string& host, const Endpoint& endpoint) {
     host_ = host;
-    ssl_ctx_ = std::make_unique<ssl::context>(ssl::context::tlsv12_client);
+    metrics_ = &metrics::Upstream(host_);
+    keep_alive_ = false;
+    if (!shared_ctx_) {
+        ssl_ctx_ = std::make_shared<ssl::context>(ssl::context::tlsv12_client);
+        ssl_ctx_->set_default_verify_paths();
+        ssl_ctx_->set_verify_mode(ssl::verify_peer);
+    }
     stream_ = std::make_unique<beast::ssl_stream<beast::tcp_stream>>(executor_, *ssl_ctx_);
 
-    ssl_ctx_->set_default_verify_paths();
-    ssl_ctx_->set_verify_mode(ssl::verify_peer);
+    if(!SSL_set_tlsext_host_name(stream_->native_handle(), host_.c_str())) {
+        throw beast::system_error(
+            static_cast<int>(::ERR_get_error()),
+            asio::error::get_ssl_category());
+    }
     stream_->set_verify_callback(ssl::host_name_verification(host_));
 
-    tcp::resolver resolver(executor_);
-    auto const resolver_result = co_await resolver.async_resolve(host_, port_, boost::asio::use_awaitable);
+    {
+        metrics::ScopedTimer timer(metrics_->connect);
+        tcp::resolver resolver(executor_);
+        auto const resolver_result = co_await resolver.async_resolve(endpoint.address.empty() ? host_ : endpoint.address,
+                                                                     endpoint.port, boost::asio::use_awaitable);
 
-    boost::beast::get_lowest_layer(*stream_).expires_after(std::chrono::seconds(TIMEOUT));
-    co_await boost::beast::get_lowest_layer(*stream_).async_connect(resolver_result, boost::asio::use_awaitable);
-
-    boost::beast::get_lowest_layer(*stream_).expires_after(std::chrono::seconds(TIMEOUT));
-    co_await stream_->async_handshake(asio::ssl::stream_base::client, boost::asio::use_awaitable);
+        boost::beast::get_lowest_layer(*stream_).expires_after(std::chrono::seconds(TIMEOUT));
+        co_await boost::beast::get_lowest_layer(*stream_).async_connect(resolver_result, boost::asio::use_awaitable);
+    }
+    {
+        metrics::ScopedTimer timer(metrics_->handshake);
+        boost::beast::get_lowest_layer(*stream_).expires_after(std::chrono::seconds(TIMEOUT));
+        co_await stream_->async_handshake(asio::ssl::stream_base::client, boost::asio::use_awaitable);
+    }
 
-    logger::LogInfo(std::string("Connected to ") + host_, "HttpsClient::Connect");
+    LOG_DEBUG(std::string("Connected to ") + host_, "HttpsClient::Connect");
     co_return;
 }
 
+/* Асинхронное отключение от сервера, не блокирует поток io_context
+ * на ожидании ответного close_notify */
+boost::asio::awaitable<void> HttpsClient::AsyncDisconnect() {
+    if (!stream_) {
+        co_return;
+    }
+    boost::system::error_code ec;
+    boost::beast::get_lowest_layer(*stream_).expires_after(std::chrono::seconds(TIMEOUT));
+    co_await stream_->async_shutdown(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    LOG_DEBUG(std::string("Disconnected from ") + host_, "HttpsClient::AsyncDisconnect");
+    CheckSSLShutdownError(ec);
+    stream_.reset();
+    if (!shared_ctx_) {
+        ssl_ctx_.reset();
+    }
+}
+
 void HttpsClient::Disconnect() {
+    if (!stream_) {
+        return;
+    }
     boost::system::error_code ec;
     stream_->shutdown(ec);
-    logger::LogInfo(std::string("Disconnected from ") + host_, "HttpsClient::Connect");
+    LOG_DEBUG(std::string("Disconnected from ") + host_, "HttpsClient::Connect");
     CheckSSLShutdownError(ec);
 }
 
@@ -66,7 +109,16 @@ bool HttpsClient::IsConnected() const noexcept {
     return ssl_ctx_ && stream_;
 }
 
-boost::asio::awaitable<std::string> HttpsClient::Exchange(http::request<http::string_body> req) {
+bool HttpsClient::KeepAlive() const noexcept {
+    return keep_alive_;
+}
+
+const std::string& HttpsClient::Host() const noexcept {
+    return host_;
+}
+
+boost::asio::awaitable<std::string> HttpsClient::Exchange(http::request<http::string_body> req,
+                                                          std::chrono::seconds timeout) {
 #ifdef Q_OS_WINDOWS
     if (!stream_->lowest_layer().is_open()) {
         logger::LogError(std::string("Нет подключения к серверу ") + host_, "HttpsClient::Exchange");
@@ -80,18 +132,27 @@ boost::asio::awaitable<std::string> HttpsClient::Exchange(http::request<http::st
     }
 #endif
     req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    boost::beast::get_lowest_layer(*stream_).expires_after(std::chrono::seconds(TIMEOUT));
-    co_await http::async_write(*stream_, req, boost::asio::use_awaitable);
-
-    boost::beast::flat_buffer buffer;
+    metrics_->requests.Inc();
     http::response<http::string_body> res;
-    co_await http::async_read(*stream_, buffer, res, boost::asio::use_awaitable);
+    try {
+        metrics::ScopedTimer timer(metrics_->transfer);
+        boost::beast::get_lowest_layer(*stream_).expires_after(timeout);
+        co_await http::async_write(*stream_, req, boost::asio::use_awaitable);
+
+        boost::beast::flat_buffer buffer;
+        co_await http::async_read(*stream_, buffer, res, boost::asio::use_awaitable);
+    } catch (...) {
+        metrics_->errors.Inc();
+        throw;
+    }
+    keep_alive_ = res.keep_alive();
     if (res.result() == http::status::ok) {
-        co_return res.body();
+        co_return std::move(res.body());
     } else {
+        metrics_->errors.Inc();
         std::stringstream ss;
         ss << "Пришёл неверный ответ от сервера:\n" << res;
-        logger::LogError(ss.str(), "HttpsClient::Exchange");
+        LOG_LIMITED(logger::Level::error, 10, ss.str(), "HttpsClient::Exchange");
     }
     co_return std::string{};
 }
@@ -8,30 +8,55 @@
 #include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
 #include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <memory>
 #include <string>
 
+namespace metrics {
+struct UpstreamMetrics;
+}
+
 namespace https_client {
 
+// Адрес подключения, отличный от имени хоста (например, локальный тестовый сервер)
+// Имя хоста по-прежнему используется для SNI и проверки сертификата
+struct Endpoint {
+    std::string address{};      // пусто - подключение по имени хоста
+    std::string port{"443"};
+};
+
 class HttpsClient {
     static constexpr int TIMEOUT = 30;
-    const std::string port_{"443"};
 
 public:
-    explicit HttpsClient(boost::asio::any_io_executor& executor);
+    static constexpr std::chrono::seconds DEFAULT_TIMEOUT{TIMEOUT};
+
+    /* ssl_ctx - общий TLS контекст (например, пула подключений),
+     * если не задан, то контекст создаётся при каждом подключении */
+    explicit HttpsClient(boost::asio::any_io_executor& executor,
+                         std::shared_ptr<boost::asio::ssl::context> ssl_ctx = nullptr);
     ~HttpsClient();
 
-    boost::asio::awaitable<void> Connect(const std::string& host);
+    boost::asio::awaitable<void> Connect(const std::string& host, const Endpoint& endpoint = {});
+    boost::asio::awaitable<void> AsyncDisconnect();
     void Disconnect();
 
     bool IsConnected() const noexcept;
+    bool KeepAlive() const noexcept; // сервер не закрывает подключение после последнего ответа
+    const std::string& Host() const noexcept;
 
-    boost::asio::awaitable<std::string> Exchange(boost::beast::http::request<boost::beast::http::string_body> req);
+    // timeout - ограничение времени на отправку запроса и получение ответа
+    boost::asio::awaitable<std::string> Exchange(boost::beast::http::request<boost::beast::http::string_body> req,
+                                                 std::chrono::seconds timeout = DEFAULT_TIMEOUT);
 
 private:
     boost::asio::any_io_executor& executor_;
     std::string host_;
+    const metrics::UpstreamMetrics* metrics_{nullptr};  // метрики текущего сервера, задаются в Connect
+    bool shared_ctx_{false};
+    bool keep_alive_{false};
 
-    std::unique_ptr<boost::asio::ssl::context> ssl_ctx_;
+    std::shared_ptr<boost::asio::ssl::context> ssl_ctx_;
     std::unique_ptr<boost::beast::ssl_stream<boost::beast::tcp_stream>> stream_;
 };
 
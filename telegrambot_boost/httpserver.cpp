@@ -0,0 +1,128 @@
+#include "logger.h"
+#include "httpserver.h"
+
+#include <chrono>
+#include <utility>
+
+namespace http_server {
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+namespace ssl = boost::asio::ssl;
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+HttpServer::HttpServer(boost::asio::any_io_executor executor, ServerSettings settings, Handler handler)
+    : executor_(std::move(executor))
+    , settings_(std::move(settings))
+    , handler_(std::move(handler))
+    , acceptor_(executor_) {
+    if (!settings_.cert_file.empty()) {
+        ssl_ctx_ = std::make_unique<ssl::context>(ssl::context::tlsv12_server);
+        ssl_ctx_->set_options(ssl::context::default_workarounds | ssl::context::no_sslv2 | ssl::context::no_sslv3);
+        ssl_ctx_->use_certificate_chain_file(settings_.cert_file);
+        ssl_ctx_->use_private_key_file(settings_.key_file, ssl::context::pem);
+    }
+}
+
+HttpServer::~HttpServer() {
+    Stop();
+}
+
+/* Приём входящих подключений, каждое подключение обслуживается в отдельной корутине */
+boost::asio::awaitable<void> HttpServer::Run() {
+    const tcp::endpoint endpoint{asio::ip::make_address(settings_.address), settings_.port};
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(asio::socket_base::reuse_address(true));
+    acceptor_.bind(endpoint);
+    acceptor_.listen(asio::socket_base::max_listen_connections);
+    logger::LogInfo(std::string("Listening on ") + settings_.address + ":" + std::to_string(settings_.port) +
+                    (ssl_ctx_ ? " (https)" : " (http)"),
+                    "HttpServer::Run");
+
+    while (acceptor_.is_open()) {
+        boost::system::error_code ec;
+        auto socket = co_await acceptor_.async_accept(asio::redirect_error(asio::use_awaitable, ec));
+        if (ec) {
+            if (ec != asio::error::operation_aborted) {
+                logger::LogError(ec.message(), "HttpServer::Run");
+            }
+            continue;
+        }
+        if (ssl_ctx_) {
+            asio::co_spawn(executor_, SslSession(std::move(socket)), asio::detached);
+        } else {
+            asio::co_spawn(executor_, Session(std::move(socket)), asio::detached);
+        }
+    }
+}
+
+void HttpServer::Stop() {
+    boost::system::error_code ec;
+    acceptor_.close(ec);
+}
+
+boost::asio::awaitable<void> HttpServer::Session(tcp::socket socket) {
+    beast::tcp_stream stream(std::move(socket));
+    try {
+        co_await Serve(stream);
+    } catch (const std::exception& err) {
+        LOG_LIMITED(logger::Level::warn, 10, err.what(), "HttpServer::Session");
+    }
+    boost::system::error_code ec;
+    stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+}
+
+boost::asio::awaitable<void> HttpServer::SslSession(tcp::socket socket) {
+    beast::ssl_stream<beast::tcp_stream> stream(std::move(socket), *ssl_ctx_);
+    try {
+        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(TIMEOUT));
+        co_await stream.async_handshake(ssl::stream_base::server, asio::use_awaitable);
+        co_await Serve(stream);
+        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(TIMEOUT));
+        co_await stream.async_shutdown(asio::use_awaitable);
+    } catch (const std::exception& err) {
+        LOG_LIMITED(logger::Level::warn, 10, err.what(), "HttpServer::SslSession");
+    }
+}
+
+/* Чтение запросов и отправка ответов, пока клиент не закроет подключение или не запросит закрытие */
+template <typename Stream>
+boost::asio::awaitable<void> HttpServer::Serve(Stream& stream) {
+    beast::flat_buffer buffer;
+    while (true) {
+        Request req;
+        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(TIMEOUT));
+        boost::system::error_code ec;
+        co_await http::async_read(stream, buffer, req, asio::redirect_error(asio::use_awaitable, ec));
+        if (ec == http::error::end_of_stream || ec == asio::ssl::error::stream_truncated) {
+            co_return;
+        }
+        if (ec) {
+            throw beast::system_error(ec);
+        }
+
+        const bool keep_alive = req.keep_alive();
+        const unsigned version = req.version();
+        Response res = co_await handler_(std::move(req));
+        res.version(version);
+        res.keep_alive(keep_alive);
+        res.prepare_payload();
+
+        beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(TIMEOUT));
+        co_await http::async_write(stream, res, asio::use_awaitable);
+        if (!keep_alive) {
+            co_return;
+        }
+    }
+}
+
+Response MakeResponse(boost::beast::http::status status, std::string body, const std::string& content_type) {
+    Response res{status, 11};
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::content_type, content_type);
+    res.body() = std::move(body);
+    return res;
+}
+
+}
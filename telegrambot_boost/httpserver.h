@@ -0,0 +1,61 @@
+#pragma once
+/*
+ * HTTP(S) сервер
+ * асинхронный на корутинах, поддерживает keep-alive
+ * Если в настройках указаны файлы сертификата и ключа, соединения принимаются по TLS,
+ * иначе - обычный HTTP (например, за обратным прокси)
+ *
+ * Использование:
+ *** http_server::HttpServer server(executor, settings, handler);
+ *** co_await server.Run();
+ * handler имеет сигнатуру boost::asio::awaitable<Response>(Request) и вызывается для каждого запроса
+ */
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace http_server {
+
+using Request = boost::beast::http::request<boost::beast::http::string_body>;
+using Response = boost::beast::http::response<boost::beast::http::string_body>;
+using Handler = std::function<boost::asio::awaitable<Response>(Request)>;
+
+struct ServerSettings {
+    std::string address{"0.0.0.0"};
+    unsigned short port{8443};
+    std::string cert_file{};    // цепочка сертификатов в формате PEM, пусто - сервер без TLS
+    std::string key_file{};     // закрытый ключ в формате PEM
+};
+
+class HttpServer {
+    static constexpr int TIMEOUT = 30;
+
+public:
+    HttpServer(boost::asio::any_io_executor executor, ServerSettings settings, Handler handler);
+    ~HttpServer();
+
+    boost::asio::awaitable<void> Run();
+    void Stop();
+
+private:
+    boost::asio::awaitable<void> Session(boost::asio::ip::tcp::socket socket);
+    boost::asio::awaitable<void> SslSession(boost::asio::ip::tcp::socket socket);
+    template <typename Stream>
+    boost::asio::awaitable<void> Serve(Stream& stream);
+
+    boost::asio::any_io_executor executor_;
+    ServerSettings settings_;
+    Handler handler_;
+    std::unique_ptr<boost::asio::ssl::context> ssl_ctx_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+};
+
+// Формирование простого ответа с заданным статусом
+Response MakeResponse(boost::beast::http::status status, std::string body = {},
+                      const std::string& content_type = "text/plain; charset=utf-8");
+
+}
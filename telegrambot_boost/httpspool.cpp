@@ -0,0 +1,123 @@
+#include "logger.h"
+#include "httpspool.h"
+
+#include <utility>
+
+namespace https_pool {
+
+namespace asio = boost::asio;
+namespace ssl = boost::asio::ssl;
+namespace beast = boost::beast;
+
+namespace {
+// Отключение выполняется в отдельной корутине, чтобы не задерживать запрос
+boost::asio::awaitable<void> Disconnect(std::unique_ptr<https_client::HttpsClient> client) {
+    try {
+        co_await client->AsyncDisconnect();
+    } catch (const std::exception& err) {
+        logger::LogError(err.what(), "HttpsPool::Disconnect");
+    }
+}
+}
+
+HttpsPool::HttpsPool(boost::asio::any_io_executor executor, PoolSettings settings)
+    : executor_(std::move(executor))
+    , settings_(std::move(settings))
+    , ssl_ctx_(std::make_shared<ssl::context>(ssl::context::tlsv12_client)) {
+    ssl_ctx_->set_default_verify_paths();
+    if (!settings_.ca_file.empty()) {
+        ssl_ctx_->load_verify_file(settings_.ca_file);
+    }
+    ssl_ctx_->set_verify_mode(ssl::verify_peer);
+}
+
+HttpsPool::~HttpsPool() = default;
+
+/* Отправка запроса через пул:
+ * 1) ждём свободный слот для хоста (не более max_connections одновременных запросов)
+ * 2) берём простаивающее подключение или создаём новое
+ * 3) если запрос на ранее использованном подключении завершился ошибкой (сервер мог закрыть его по таймауту),
+ *    повторяем запрос один раз на новом подключении
+ * 4) если сервер не закрывает подключение, возвращаем его в пул */
+boost::asio::awaitable<std::string> HttpsPool::Exchange(const std::string& host, RequestType req,
+                                                        std::chrono::seconds timeout) {
+    auto slot = co_await GetHostPool(host).slots->Acquire();
+
+    for (int attempt = 0; ; ++attempt) {
+        auto client = TakeIdle(GetHostPool(host));
+        const bool reused = (client != nullptr);
+        if (!reused) {
+            client = std::make_unique<https_client::HttpsClient>(executor_, ssl_ctx_);
+            const auto endpoint = settings_.endpoints.find(host);
+            co_await client->Connect(host, endpoint != settings_.endpoints.end() ? endpoint->second
+                                                                                  : https_client::Endpoint{});
+        }
+
+        std::string body;
+        bool stale{false};
+        try {
+            body = co_await client->Exchange(req, timeout);
+        } catch (const beast::system_error& err) {
+            if (!reused || attempt > 0) {
+                throw;
+            }
+            LOG_DEBUG(std::string("Stale connection to ") + host + ": " + err.what(), "HttpsPool::Exchange");
+            stale = true;
+        }
+        if (stale) {
+            Close(std::move(client));
+            continue;
+        }
+
+        if (client->KeepAlive()) {
+            GetHostPool(host).idle.push_back({std::move(client), Clock::now()});
+        } else {
+            Close(std::move(client));
+        }
+        co_return body;
+    }
+}
+
+void HttpsPool::EvictIdle() {
+    const auto now = Clock::now();
+    for (auto& [host, host_pool] : hosts_) {
+        EvictIdle(host_pool, now);
+    }
+}
+
+HttpsPool::HostPool& HttpsPool::GetHostPool(const std::string& host) {
+    auto it = hosts_.find(host);
+    if (it == hosts_.end()) {
+        it = hosts_.emplace(host, HostPool{std::make_unique<async_util::Semaphore>(executor_,
+                                                                                   settings_.max_connections),
+                                           {}}).first;
+    }
+    return it->second;
+}
+
+// Берём самое "свежее" подключение, предварительно закрыв устаревшие
+std::unique_ptr<https_client::HttpsClient> HttpsPool::TakeIdle(HostPool& host_pool) {
+    EvictIdle(host_pool, Clock::now());
+    if (host_pool.idle.empty()) {
+        return nullptr;
+    }
+    auto client = std::move(host_pool.idle.back().client);
+    host_pool.idle.pop_back();
+    return client;
+}
+
+void HttpsPool::EvictIdle(HostPool& host_pool, Clock::time_point now) {
+    std::erase_if(host_pool.idle, [this, now](IdleConnection& conn) {
+        if (now - conn.last_used < settings_.idle_timeout) {
+            return false;
+        }
+        Close(std::move(conn.client));
+        return true;
+    });
+}
+
+void HttpsPool::Close(std::unique_ptr<https_client::HttpsClient> client) {
+    asio::co_spawn(executor_, Disconnect(std::move(client)), asio::detached);
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+/*
+ * Пул постоянных (HTTP/1.1 keep-alive) HTTPS подключений, отдельный для каждого хоста
+ * - общий TLS контекст для всех подключений
+ * - ограничение количества одновременных подключений к одному хосту
+ * - подключения, простаивающие дольше idle_timeout, закрываются
+ * - если сервер закрыл простаивающее подключение, запрос прозрачно повторяется на новом подключении
+ *
+ * Использование:
+ *** auto pool = std::make_shared<https_pool::HttpsPool>(ioc.get_executor());
+ *** std::string body = co_await pool->Exchange(host, std::move(req));
+ */
+#include "asyncutil.h"
+#include "httpsclient.h"
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace https_pool {
+
+using RequestType = boost::beast::http::request<boost::beast::http::string_body>;
+
+struct PoolSettings {
+    size_t max_connections{8};                // максимальное количество подключений к одному хосту
+    std::chrono::seconds idle_timeout{50};    // время простоя, после которого подключение закрывается
+    // Подмена адресов хостов (например, на локальные тестовые серверы в нагрузочном тесте)
+    std::unordered_map<std::string, https_client::Endpoint> endpoints{};
+    std::string ca_file{};                    // дополнительный доверенный сертификат в формате PEM (самоподписанный сертификат тестовых серверов)
+};
+
+class HttpsPool {
+    using Clock = std::chrono::steady_clock;
+
+public:
+    explicit HttpsPool(boost::asio::any_io_executor executor, PoolSettings settings = {});
+    ~HttpsPool();
+
+    HttpsPool(const HttpsPool&) = delete;
+    HttpsPool& operator=(const HttpsPool&) = delete;
+
+    // Отправка запроса на хост по свободному подключению из пула, возвращает тело ответа
+    boost::asio::awaitable<std::string> Exchange(const std::string& host, RequestType req,
+                                                 std::chrono::seconds timeout = https_client::HttpsClient::DEFAULT_TIMEOUT);
+
+    void EvictIdle(); // закрытие подключений, простаивающих дольше idle_timeout
+
+private:
+    struct IdleConnection {
+        std::unique_ptr<https_client::HttpsClient> client;
+        Clock::time_point last_used;
+    };
+    struct HostPool {
+        std::unique_ptr<async_util::Semaphore> slots;   // ограничение одновременных подключений
+        std::vector<IdleConnection> idle;               // свободные подключения, последнее - самое "свежее"
+    };
+
+    HostPool& GetHostPool(const std::string& host);
+    std::unique_ptr<https_client::HttpsClient> TakeIdle(HostPool& host_pool);
+    void EvictIdle(HostPool& host_pool, Clock::time_point now);
+    void Close(std::unique_ptr<https_client::HttpsClient> client);
+
+    boost::asio::any_io_executor executor_;
+    PoolSettings settings_;
+    std::shared_ptr<boost::asio::ssl::context> ssl_ctx_;
+    std::unordered_map<std::string, HostPool> hosts_;
+};
+
+}
@@ -0,0 +1,266 @@
+/*
+ * Нагрузочный тест бота без обращения к внешним сервисам
+ * Настоящие TelegramBot и MeteoBot (в одном потоке, как в main.cpp бота) работают через пул подключений,
+ * в котором адреса api.telegram.org, geocode-maps.yandex.ru и api.open-meteo.com подменены на локальные
+ * TLS серверы-заменители (stubs.h), работающие в отдельном потоке
+ * Результат: сообщений в секунду и время от выдачи сообщения в getUpdates до получения ответа в sendMessage
+ *
+ * Параметры задаются в виде --имя=значение, например:
+ *** ./loadtest --updates=20000 --rate=500 --towns=5000 --zipf=1.1 --forecast_latency_ms=80 --forecast_error_rate=0.01
+ * При одинаковых параметрах (и seed) последовательность сообщений одинакова
+ */
+#include "stubs.h"
+
+#include "../httpspool.h"
+#include "../logger.h"
+#include "../meteobot.h"
+#include "../metrics.h"
+#include "../telegrambot.h"
+
+#include <boost/asio.hpp>
+#include <boost/log/utility/setup/console.hpp>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace {
+
+constexpr static char TELEGRAM_HOST[]{"api.telegram.org"};
+constexpr static char GEOCODE_HOST[]{"geocode-maps.yandex.ru"};
+constexpr static char FORECAST_HOST[]{"api.open-meteo.com"};
+constexpr static char TOKEN[]{"loadtest"};
+
+struct Options {
+    load_test::WorkloadSettings workload{};
+    load_test::StubBehavior telegram{};
+    load_test::StubBehavior geocode{.latency = std::chrono::milliseconds{30}, .jitter = std::chrono::milliseconds{20}};
+    load_test::StubBehavior forecast{.latency = std::chrono::milliseconds{60}, .jitter = std::chrono::milliseconds{40}};
+    unsigned short port_base{18443};        // порты заменителей: port_base, port_base + 1, port_base + 2
+    size_t max_parallel{64};                // ReplySettings бота
+    size_t max_connections{16};             // PoolSettings бота
+    std::chrono::seconds time_limit{600};   // тест прерывается, если не завершился за это время
+    bool print_metrics{false};              // вывести метрики бота (metrics::Global) после теста
+};
+
+// Разбор аргументов вида --name=value
+std::map<std::string, std::string, std::less<>> ParseArgs(int argc, char* argv[]) {
+    std::map<std::string, std::string, std::less<>> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg(argv[i]);
+        if (!arg.starts_with("--")) {
+            throw std::invalid_argument(std::format("Unexpected argument: {}", arg));
+        }
+        arg.remove_prefix(2);
+        const size_t eq = arg.find('=');
+        args.emplace(std::string(arg.substr(0, eq)), eq == std::string_view::npos ? "1" : std::string(arg.substr(eq + 1)));
+    }
+    return args;
+}
+
+template <typename T>
+void Read(std::map<std::string, std::string, std::less<>>& args, std::string_view name, T& value) {
+    auto it = args.find(name);
+    if (it == args.end()) {
+        return;
+    }
+    const std::string& text = it->second;
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size()) {
+        throw std::invalid_argument(std::format("Bad value of --{}: {}", name, text));
+    }
+    args.erase(it);
+}
+
+void Read(std::map<std::string, std::string, std::less<>>& args, std::string_view name, std::chrono::milliseconds& value) {
+    int64_t count = value.count();
+    Read(args, name, count);
+    value = std::chrono::milliseconds{count};
+}
+
+void ReadBehavior(std::map<std::string, std::string, std::less<>>& args, const std::string& prefix,
+                  load_test::StubBehavior& behavior) {
+    Read(args, prefix + "_latency_ms", behavior.latency);
+    Read(args, prefix + "_jitter_ms", behavior.jitter);
+    Read(args, prefix + "_error_rate", behavior.error_rate);
+}
+
+Options ParseOptions(int argc, char* argv[]) {
+    auto args = ParseArgs(argc, argv);
+    Options options;
+    Read(args, "updates", options.workload.updates);
+    Read(args, "rate", options.workload.rate);
+    Read(args, "chats", options.workload.chats);
+    Read(args, "towns", options.workload.towns);
+    Read(args, "zipf", options.workload.zipf);
+    Read(args, "not_found_rate", options.workload.not_found_rate);
+    Read(args, "seed", options.workload.seed);
+    ReadBehavior(args, "telegram", options.telegram);
+    ReadBehavior(args, "geocode", options.geocode);
+    ReadBehavior(args, "forecast", options.forecast);
+    Read(args, "port_base", options.port_base);
+    Read(args, "max_parallel", options.max_parallel);
+    Read(args, "max_connections", options.max_connections);
+    int64_t time_limit = options.time_limit.count();
+    Read(args, "time_limit_s", time_limit);
+    options.time_limit = std::chrono::seconds{time_limit};
+    if (args.erase("metrics")) {
+        options.print_metrics = true;
+    }
+    if (!args.empty()) {
+        throw std::invalid_argument(std::format("Unknown option: --{}", args.begin()->first));
+    }
+    return options;
+}
+
+struct WeatherGet {
+    boost::asio::awaitable<telega::ReplyPtr> operator()(std::string town, tracing::TracePtr trace) {
+        co_return co_await bot->GetWeather(std::move(town), std::move(trace));
+    }
+
+    std::shared_ptr<meteo::MeteoBot> bot;
+};
+
+std::string Seconds(uint64_t micros) {
+    return std::format("{:.3f}", static_cast<double>(micros) / 1e6);
+}
+
+void PrintReport(const Options& options, const load_test::TelegramStub& telegram, const load_test::GeocodeStub& geocode,
+                 const load_test::ForecastStub& forecast, bool completed) {
+    const double elapsed = std::chrono::duration<double>(telegram.Elapsed()).count();
+    const auto& latency = telegram.ReplyLatency();
+    std::cout << std::format("{}\n", completed ? "Completed" : "Time limit reached, partial results")
+              << std::format("updates sent: {}, replies: {}, lost replies (sendMessage errors): {}\n",
+                             telegram.Sent(), telegram.Replied(), telegram.ReplyErrors())
+              << std::format("elapsed: {:.3f} s, throughput: {:.1f} updates/s\n",
+                             elapsed, elapsed > 0 ? static_cast<double>(telegram.Replied()) / elapsed : 0.0)
+              << std::format("reply latency, s: p50 {} p90 {} p99 {} p99.9 {} mean {}\n",
+                             Seconds(latency.Quantile(0.5)), Seconds(latency.Quantile(0.9)),
+                             Seconds(latency.Quantile(0.99)), Seconds(latency.Quantile(0.999)),
+                             Seconds(latency.Count() ? latency.Sum() / latency.Count() : 0))
+              << std::format("telegram requests: {} (errors {}), geocode requests: {} (errors {}), "
+                             "forecast requests: {} (errors {}, locations {})\n",
+                             telegram.Requests(), telegram.Errors(), geocode.Requests(), geocode.Errors(),
+                             forecast.Requests(), forecast.Errors(), forecast.Locations())
+              << std::format("workload: towns {} zipf {} chats {} rate {} seed {}\n",
+                             options.workload.towns, options.workload.zipf, options.workload.chats,
+                             options.workload.rate, options.workload.seed);
+    if (options.print_metrics) {
+        std::cout << "\n" << metrics::Global().Serialize();
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    boost::log::add_console_log(std::clog, boost::log::keywords::format = &(logger::LogFormatter));
+    logger::SetLevel(logger::Level::warn);
+    logger::StartAsync();
+
+    const auto dir = std::filesystem::temp_directory_path() / "meteobot_loadtest";
+    std::filesystem::create_directories(dir);
+    const std::string cert_file = (dir / "cert.pem").string();
+    const std::string key_file = (dir / "key.pem").string();
+    load_test::GenerateCertificate(cert_file, key_file, {TELEGRAM_HOST, GEOCODE_HOST, FORECAST_HOST});
+
+    boost::asio::io_context bot_ioc;
+    boost::asio::io_context stub_ioc;
+    bool completed{false};
+
+    // заменители в отдельном потоке, чтобы их работа не отнимала время у бота
+    load_test::TelegramStub telegram(stub_ioc.get_executor(), options.telegram, options.workload, [&] {
+        completed = true;
+        bot_ioc.stop();
+    });
+    load_test::GeocodeStub geocode(stub_ioc.get_executor(), options.geocode, options.workload);
+    load_test::ForecastStub forecast(stub_ioc.get_executor(), options.forecast, options.workload.seed);
+
+    auto server_settings = [&](unsigned short offset) {
+        return http_server::ServerSettings{.address = "127.0.0.1",
+                                           .port = static_cast<unsigned short>(options.port_base + offset),
+                                           .cert_file = cert_file,
+                                           .key_file = key_file};
+    };
+    http_server::HttpServer telegram_server(stub_ioc.get_executor(), server_settings(0), [&](http_server::Request req) {
+        return telegram.Handle(std::move(req));
+    });
+    http_server::HttpServer geocode_server(stub_ioc.get_executor(), server_settings(1), [&](http_server::Request req) {
+        return geocode.Handle(std::move(req));
+    });
+    http_server::HttpServer forecast_server(stub_ioc.get_executor(), server_settings(2), [&](http_server::Request req) {
+        return forecast.Handle(std::move(req));
+    });
+    boost::asio::co_spawn(stub_ioc, telegram_server.Run(), boost::asio::detached);
+    boost::asio::co_spawn(stub_ioc, geocode_server.Run(), boost::asio::detached);
+    boost::asio::co_spawn(stub_ioc, forecast_server.Run(), boost::asio::detached);
+    auto stub_work = boost::asio::make_work_guard(stub_ioc);
+    std::thread stub_thread([&stub_ioc] { stub_ioc.run(); });
+
+    // сокеты серверов открываются в начале Run, к моменту выполнения post они уже слушают
+    std::promise<void> listening;
+    boost::asio::post(stub_ioc, [&listening] { listening.set_value(); });
+    listening.get_future().wait();
+
+    auto endpoint = [&](unsigned short offset) {
+        return https_client::Endpoint{.address = "127.0.0.1", .port = std::to_string(options.port_base + offset)};
+    };
+    auto pool = std::make_shared<https_pool::HttpsPool>(
+        bot_ioc.get_executor(),
+        https_pool::PoolSettings{.max_connections = options.max_connections,
+                                 .idle_timeout = std::chrono::seconds{50},
+                                 .endpoints = {{TELEGRAM_HOST, endpoint(0)},
+                                               {GEOCODE_HOST, endpoint(1)},
+                                               {FORECAST_HOST, endpoint(2)}},
+                                 .ca_file = cert_file});
+    auto meteo_bot = std::make_shared<meteo::MeteoBot>(bot_ioc.get_executor(), pool);
+    boost::asio::co_spawn(bot_ioc, meteo_bot->RunRefresh(), boost::asio::detached);
+    boost::asio::co_spawn(bot_ioc,
+                          telega::RunTelegramBot(TOKEN, WeatherGet{meteo_bot}, pool,
+                                                 telega::PollSettings{.timeout = 1, .limit = 100},
+                                                 telega::ReplySettings{.max_parallel = options.max_parallel}),
+                          boost::asio::detached);
+
+    boost::asio::steady_timer time_limit(bot_ioc, options.time_limit);
+    time_limit.async_wait([&bot_ioc](const boost::system::error_code& ec) {
+        if (!ec) {
+            bot_ioc.stop();
+        }
+    });
+    bot_ioc.run();
+
+    // результаты читаются в потоке заменителей, пока он ещё работает
+    std::promise<void> reported;
+    boost::asio::post(stub_ioc, [&] {
+        PrintReport(options, telegram, geocode, forecast, completed);
+        telegram_server.Stop();
+        geocode_server.Stop();
+        forecast_server.Stop();
+        reported.set_value();
+    });
+    reported.get_future().wait();
+    stub_work.reset();
+    stub_ioc.stop();
+    stub_thread.join();
+
+    logger::StopAsync();
+    return completed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,415 @@
+#include "stubs.h"
+
+#include <boost/json.hpp>
+#include <boost/url/parse.hpp>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace load_test {
+
+namespace asio = boost::asio;
+namespace http = boost::beast::http;
+namespace json = boost::json;
+
+namespace {
+
+template <typename T, void (*Free)(T*)>
+struct OpensslDeleter {
+    void operator()(T* ptr) const noexcept {
+        Free(ptr);
+    }
+};
+
+using PkeyPtr = std::unique_ptr<EVP_PKEY, OpensslDeleter<EVP_PKEY, EVP_PKEY_free>>;
+using X509Ptr = std::unique_ptr<X509, OpensslDeleter<X509, X509_free>>;
+using ExtensionPtr = std::unique_ptr<X509_EXTENSION, OpensslDeleter<X509_EXTENSION, X509_EXTENSION_free>>;
+
+void Check(bool ok, const char* what) {
+    if (!ok) {
+        throw std::runtime_error(std::format("OpenSSL: {} failed", what));
+    }
+}
+
+void AddExtension(X509* cert, int nid, const std::string& value) {
+    X509V3_CTX ctx;
+    X509V3_set_ctx_nodb(&ctx);
+    X509V3_set_ctx(&ctx, cert, cert, nullptr, nullptr, 0);
+    ExtensionPtr ext(X509V3_EXT_conf_nid(nullptr, &ctx, nid, value.c_str()));
+    Check(ext != nullptr && X509_add_ext(cert, ext.get(), -1) == 1, "X509_add_ext");
+}
+
+// FNV-1a: одинаковый результат на всех платформах, в отличие от std::hash
+uint64_t Hash(std::string_view text) {
+    uint64_t hash{14695981039346656037ull};
+    for (const char ch : text) {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+http_server::Response JsonResponse(const json::value& value) {
+    return http_server::MakeResponse(http::status::ok, json::serialize(value), "application/json");
+}
+
+http_server::Response ErrorResponse() {
+    return http_server::MakeResponse(http::status::internal_server_error, "stub error");
+}
+
+}
+
+void GenerateCertificate(const std::string& cert_file, const std::string& key_file,
+                         const std::vector<std::string>& hosts) {
+    PkeyPtr key(EVP_EC_gen("P-256"));
+    Check(key != nullptr, "EVP_EC_gen");
+
+    X509Ptr cert(X509_new());
+    Check(cert != nullptr, "X509_new");
+    X509_set_version(cert.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), -60);
+    X509_gmtime_adj(X509_getm_notAfter(cert.get()), 7 * 24 * 3600);
+    X509_set_pubkey(cert.get(), key.get());
+
+    X509_NAME* name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char*>("meteobot load test"), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+
+    std::string alt_names;
+    for (const auto& host : hosts) {
+        alt_names += (alt_names.empty() ? "DNS:" : ",DNS:") + host;
+    }
+    AddExtension(cert.get(), NID_basic_constraints, "critical,CA:TRUE");
+    AddExtension(cert.get(), NID_subject_alt_name, alt_names);
+    Check(X509_sign(cert.get(), key.get(), EVP_sha256()) > 0, "X509_sign");
+
+    auto write_pem = [](const std::string& file_name, auto&& write) {
+        std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(file_name.c_str(), "wb"), &std::fclose);
+        Check(file != nullptr && write(file.get()) == 1, "PEM write");
+    };
+    write_pem(cert_file, [&](FILE* file) { return PEM_write_X509(file, cert.get()); });
+    write_pem(key_file, [&](FILE* file) {
+        return PEM_write_PrivateKey(file, key.get(), nullptr, nullptr, 0, nullptr, nullptr);
+    });
+}
+
+/* -------- ZipfDistribution -------- */
+
+ZipfDistribution::ZipfDistribution(size_t n, double s)
+    : cdf_(std::max<size_t>(n, 1)) {
+    double sum{0};
+    for (size_t i = 0; i < cdf_.size(); ++i) {
+        sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+        cdf_[i] = sum;
+    }
+    for (auto& value : cdf_) {
+        value /= sum;
+    }
+}
+
+size_t ZipfDistribution::operator()(std::mt19937_64& rng) const {
+    const double point = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    const auto it = std::lower_bound(cdf_.begin(), cdf_.end(), point);
+    return std::min(static_cast<size_t>(it - cdf_.begin()), cdf_.size() - 1);
+}
+
+/* -------- Stub -------- */
+
+Stub::Stub(boost::asio::any_io_executor executor, StubBehavior behavior, uint64_t seed)
+    : executor_(std::move(executor))
+    , behavior_(behavior)
+    , rng_(seed) {}
+
+uint64_t Stub::Requests() const noexcept {
+    return requests_;
+}
+
+uint64_t Stub::Errors() const noexcept {
+    return errors_;
+}
+
+boost::asio::awaitable<void> Stub::Delay() {
+    auto delay = behavior_.latency;
+    if (behavior_.jitter.count() > 0) {
+        delay += std::chrono::milliseconds(
+            std::uniform_int_distribution<int64_t>(0, behavior_.jitter.count())(rng_));
+    }
+    if (delay.count() > 0) {
+        asio::steady_timer timer(executor_, delay);
+        co_await timer.async_wait(asio::use_awaitable);
+    }
+}
+
+bool Stub::InjectError() {
+    ++requests_;
+    if (behavior_.error_rate > 0 && std::bernoulli_distribution(behavior_.error_rate)(rng_)) {
+        ++errors_;
+        return true;
+    }
+    return false;
+}
+
+/* -------- TelegramStub -------- */
+
+TelegramStub::TelegramStub(boost::asio::any_io_executor executor, StubBehavior behavior, WorkloadSettings workload,
+                           std::function<void()> on_done)
+    : Stub(std::move(executor), behavior, workload.seed)
+    , workload_(workload)
+    , on_done_(std::move(on_done))
+    , towns_(workload.towns, workload.zipf)
+    , chats_(1, std::max<uint32_t>(workload.chats, 1)) {}
+
+std::string TelegramStub::TownName(size_t index) {
+    return std::format("Town {}", index + 1);
+}
+
+/* Маршрутизация по методу API: /bot<token>/<method> */
+boost::asio::awaitable<http_server::Response> TelegramStub::Handle(http_server::Request req) {
+    const std::string_view target(req.target());
+    const std::string_view method = target.substr(target.rfind('/') + 1);
+    co_await Delay();
+    const bool error = InjectError();
+    if (method == "sendMessage") {
+        co_return SendMessage(req.body(), error);
+    }
+    if (error) {
+        co_return ErrorResponse();
+    }
+    if (method == "getUpdates") {
+        co_return co_await GetUpdates(req.body());
+    }
+    co_return JsonResponse(json::object{{"ok", true}, {"result", true}});
+}
+
+/* Без ограничения частоты каждый запрос получает limit новых сообщений.
+ * С ограничением выдаются сообщения, время которых наступило; если таких нет, запрос ждёт
+ * следующего сообщения (не дольше timeout, как и настоящий long polling).
+ * Подтверждение через offset не отслеживается: каждое сообщение выдаётся один раз */
+boost::asio::awaitable<http_server::Response> TelegramStub::GetUpdates(const std::string& body) {
+    const auto request = json::parse(body).as_object();
+    const uint64_t limit = request.contains("limit") ? request.at("limit").to_number<uint64_t>() : 100;
+    const auto timeout = std::chrono::seconds(request.contains("timeout") ? request.at("timeout").to_number<int64_t>() : 0);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (sent_ == 0) {
+        started_ = now;
+    }
+    uint64_t count = std::min(limit, workload_.updates - sent_);
+    if (workload_.rate > 0 && count > 0) {
+        auto due_at = [this](uint64_t index) {
+            return started_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                  std::chrono::duration<double>(static_cast<double>(index) / workload_.rate));
+        };
+        if (due_at(sent_) > now) {
+            asio::steady_timer timer(executor_, std::min(due_at(sent_), now + timeout));
+            co_await timer.async_wait(asio::use_awaitable);
+        }
+        const auto ready = std::chrono::steady_clock::now();
+        uint64_t due{0};
+        while (due < count && due_at(sent_ + due) <= ready) {
+            ++due;
+        }
+        count = due;
+    } else if (count == 0) {
+        // все сообщения выданы: ждём, как сервер без новых обновлений
+        asio::steady_timer timer(executor_, timeout);
+        co_await timer.async_wait(asio::use_awaitable);
+    }
+
+    json::array updates;
+    const auto sent_at = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; ++i) {
+        const int64_t update_id = static_cast<int64_t>(++sent_);
+        const int64_t chat_id = chats_(rng_);
+        pending_[chat_id].push_back(sent_at);
+        updates.push_back(json::object{
+            {"update_id", update_id},
+            {"message", json::object{{"message_id", update_id},
+                                     {"date", 0},
+                                     {"chat", json::object{{"id", chat_id}, {"type", "private"}}},
+                                     {"text", TownName(towns_(rng_))}}}});
+    }
+    co_return JsonResponse(json::object{{"ok", true}, {"result", std::move(updates)}});
+}
+
+/* Ответы одного чата приходят в порядке сообщений, поэтому время выдачи берётся из начала очереди чата
+ * Ответ, на который заменитель вернул ошибку, считается потерянным: бот не повторяет sendMessage */
+http_server::Response TelegramStub::SendMessage(const std::string& body, bool error) {
+    const auto request = json::parse(body).as_object();
+    const auto& chat_value = request.at("chat_id");
+    const int64_t chat_id = chat_value.is_string() ? std::stoll(std::string(chat_value.as_string()))
+                                                   : chat_value.to_number<int64_t>();
+    auto it = pending_.find(chat_id);
+    if (it == pending_.end() || it->second.empty()) {
+        return JsonResponse(json::object{{"ok", false}, {"description", "unexpected reply"}});
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (error) {
+        ++reply_errors_;
+    } else {
+        reply_latency_.Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(now - it->second.front()).count()));
+        ++replied_;
+    }
+    it->second.pop_front();
+    if (replied_ + reply_errors_ == workload_.updates) {
+        finished_ = now;
+        on_done_();
+    }
+    if (error) {
+        return ErrorResponse();
+    }
+    return JsonResponse(json::object{{"ok", true}, {"result", json::object{{"message_id", replied_}}}});
+}
+
+uint64_t TelegramStub::Sent() const noexcept {
+    return sent_;
+}
+
+uint64_t TelegramStub::Replied() const noexcept {
+    return replied_;
+}
+
+uint64_t TelegramStub::ReplyErrors() const noexcept {
+    return reply_errors_;
+}
+
+std::chrono::steady_clock::duration TelegramStub::Elapsed() const noexcept {
+    return (finished_ == std::chrono::steady_clock::time_point{} ? std::chrono::steady_clock::now() : finished_) -
+           started_;
+}
+
+const metrics::Histogram& TelegramStub::ReplyLatency() const noexcept {
+    return reply_latency_;
+}
+
+/* -------- GeocodeStub -------- */
+
+GeocodeStub::GeocodeStub(boost::asio::any_io_executor executor, StubBehavior behavior, WorkloadSettings workload)
+    : Stub(std::move(executor), behavior, workload.seed + 1)
+    , not_found_rate_(workload.not_found_rate) {}
+
+/* Координаты и признак "не найден" вычисляются по названию, поэтому одно название всегда даёт один ответ */
+boost::asio::awaitable<http_server::Response> GeocodeStub::Handle(http_server::Request req) {
+    co_await Delay();
+    if (InjectError()) {
+        co_return ErrorResponse();
+    }
+    auto url = boost::urls::parse_origin_form(std::string_view(req.target()));
+    if (!url) {
+        co_return http_server::MakeResponse(http::status::bad_request);
+    }
+    std::string town;
+    if (auto it = url->params().find("geocode"); it != url->params().end()) {
+        town = (*it).value;
+    }
+    const uint64_t hash = Hash(town);
+    const bool found = static_cast<double>(hash % 10000) >= not_found_rate_ * 10000;
+    const double latitude = 41.0 + static_cast<double>((hash >> 16) % 29000) / 1000.0;
+    const double longitude = 20.0 + static_cast<double>((hash >> 32) % 160000) / 1000.0;
+
+    json::array members;
+    if (found) {
+        members.push_back(json::object{
+            {"GeoObject", json::object{
+                {"metaDataProperty", json::object{{"GeocoderMetaData", json::object{{"text", "Россия, " + town}}}}},
+                {"Point", json::object{{"pos", std::format("{:.6f} {:.6f}", longitude, latitude)}}}}}});
+    }
+    co_return JsonResponse(json::object{
+        {"response", json::object{
+            {"GeoObjectCollection", json::object{
+                {"metaDataProperty", json::object{
+                    {"GeocoderResponseMetaData", json::object{{"found", found ? "1" : "0"}}}}},
+                {"featureMember", std::move(members)}}}}}});
+}
+
+/* -------- ForecastStub -------- */
+
+ForecastStub::ForecastStub(boost::asio::any_io_executor executor, StubBehavior behavior, uint64_t seed)
+    : Stub(std::move(executor), behavior, seed + 2) {}
+
+uint64_t ForecastStub::Locations() const noexcept {
+    return locations_;
+}
+
+/* Ответ в формате open-meteo: объект для одной точки, массив объектов для нескольких
+ * Количество значений - на два дня с шагом temporal_resolution=hourly_N, начиная с полуночи текущих суток
+ * по Москве; время - unix time при timeformat=unixtime, иначе строки ISO 8601 */
+boost::asio::awaitable<http_server::Response> ForecastStub::Handle(http_server::Request req) {
+    co_await Delay();
+    if (InjectError()) {
+        co_return ErrorResponse();
+    }
+    auto url = boost::urls::parse_origin_form(std::string_view(req.target()));
+    if (!url) {
+        co_return http_server::MakeResponse(http::status::bad_request);
+    }
+    std::string latitudes;
+    int step{1};
+    bool unix_time{false};
+    for (const auto& param : url->params()) {
+        if (param.key == "latitude") {
+            latitudes = param.value;
+        } else if (param.key == "temporal_resolution" && param.value.starts_with("hourly_")) {
+            step = std::max(1, std::stoi(param.value.substr(7)));
+        } else if (param.key == "timeformat") {
+            unix_time = param.value == "unixtime";
+        }
+    }
+    constexpr int64_t UTC_OFFSET{3 * 3600};
+    const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    const int64_t midnight = (now + UTC_OFFSET) / 86400 * 86400 - UTC_OFFSET;
+    const size_t count = static_cast<size_t>(std::count(latitudes.begin(), latitudes.end(), ',')) + 1;
+    locations_ += count;
+
+    std::uniform_real_distribution<double> temperature(-20.0, 30.0);
+    std::uniform_real_distribution<double> precipitation(0.0, 2.0);
+    json::array forecasts;
+    for (size_t i = 0; i < count; ++i) {
+        json::array time;
+        json::array temperature_2m;
+        json::array rain;
+        json::array snowfall;
+        for (int hour = 0; hour < 48; hour += step) {
+            const int64_t timestamp = midnight + hour * 3600;
+            if (unix_time) {
+                time.push_back(timestamp);
+            } else {
+                const std::chrono::sys_seconds local{std::chrono::seconds{timestamp + UTC_OFFSET}};
+                time.push_back(json::string(std::format("{:%Y-%m-%dT%H:%M}", local)));
+            }
+            temperature_2m.push_back(std::round(temperature(rng_) * 10) / 10);
+            rain.push_back(std::round(precipitation(rng_) * 10) / 10);
+            snowfall.push_back(0.0);
+        }
+        forecasts.push_back(json::object{
+            {"latitude", 0.0},
+            {"longitude", 0.0},
+            {"utc_offset_seconds", UTC_OFFSET},
+            {"timezone", "Europe/Moscow"},
+            {"hourly_units", json::object{{"time", unix_time ? "unixtime" : "iso8601"}, {"temperature_2m", "°C"},
+                                          {"rain", "mm"}, {"snowfall", "cm"}}},
+            {"hourly", json::object{{"time", std::move(time)},
+                                    {"temperature_2m", std::move(temperature_2m)},
+                                    {"rain", std::move(rain)},
+                                    {"snowfall", std::move(snowfall)}}}});
+    }
+    if (count == 1) {
+        co_return JsonResponse(forecasts.front());
+    }
+    co_return JsonResponse(forecasts);
+}
+
+}
@@ -0,0 +1,132 @@
+#pragma once
+/*
+ * Локальные заменители внешних сервисов для нагрузочного теста
+ * - TelegramStub - api.telegram.org: getUpdates выдаёт сообщения от модели пользователей
+ *   (чат выбирается равномерно, город - по распределению Ципфа), sendMessage принимает ответы
+ *   и измеряет время от выдачи сообщения до получения ответа
+ * - GeocodeStub - geocode-maps.yandex.ru: координаты, вычисляемые по названию города
+ * - ForecastStub - api.open-meteo.com: прогноз для одной или нескольких точек
+ * У каждого заменителя настраиваются задержка ответа и доля ответов с ошибкой (500)
+ * Заменители работают в одном потоке своего io_context и обслуживаются http_server::HttpServer по TLS
+ * с самоподписанным сертификатом (GenerateCertificate)
+ */
+#include "../httpserver.h"
+#include "../metrics.h"
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace load_test {
+
+struct StubBehavior {
+    std::chrono::milliseconds latency{0};   // задержка каждого ответа
+    std::chrono::milliseconds jitter{0};    // случайная добавка к задержке, равномерно в [0, jitter]
+    double error_rate{0.0};                 // доля ответов с кодом 500
+};
+
+struct WorkloadSettings {
+    uint64_t updates{10000};    // сколько сообщений отправить боту
+    double rate{0.0};           // сообщений в секунду, 0 - без ограничения (каждый getUpdates получает limit сообщений)
+    uint32_t chats{1000};       // количество пользователей (чатов)
+    uint32_t towns{2000};       // количество разных городов
+    double zipf{1.0};           // показатель распределения Ципфа популярности городов
+    double not_found_rate{0.01}; // доля названий, для которых geocode не находит город
+    uint64_t seed{1};
+};
+
+// Самоподписанный сертификат (он же корневой для проверки) с именами hosts в subjectAltName
+void GenerateCertificate(const std::string& cert_file, const std::string& key_file,
+                         const std::vector<std::string>& hosts);
+
+// Выбор номера от 0 до n - 1 с вероятностью, пропорциональной 1 / (номер + 1)^s
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t n, double s);
+
+    size_t operator()(std::mt19937_64& rng) const;
+
+private:
+    std::vector<double> cdf_;
+};
+
+// Общая часть заменителей: задержка и ошибки
+class Stub {
+public:
+    Stub(boost::asio::any_io_executor executor, StubBehavior behavior, uint64_t seed);
+
+    uint64_t Requests() const noexcept;
+    uint64_t Errors() const noexcept;   // ответов с ошибкой
+
+protected:
+    boost::asio::awaitable<void> Delay();
+    bool InjectError(); // учитывает запрос, true - нужно ответить ошибкой
+
+    boost::asio::any_io_executor executor_;
+    StubBehavior behavior_;
+    std::mt19937_64 rng_;
+    uint64_t requests_{};
+    uint64_t errors_{};
+};
+
+class TelegramStub : public Stub {
+public:
+    TelegramStub(boost::asio::any_io_executor executor, StubBehavior behavior, WorkloadSettings workload,
+                 std::function<void()> on_done);
+
+    boost::asio::awaitable<http_server::Response> Handle(http_server::Request req);
+
+    uint64_t Sent() const noexcept;             // выдано сообщений
+    uint64_t Replied() const noexcept;          // получено ответов
+    uint64_t ReplyErrors() const noexcept;      // ответов, на которые заменитель ответил ошибкой
+    std::chrono::steady_clock::duration Elapsed() const noexcept; // от первого сообщения до последнего ответа
+    const metrics::Histogram& ReplyLatency() const noexcept;      // микросекунды
+
+    static std::string TownName(size_t index);
+
+private:
+    boost::asio::awaitable<http_server::Response> GetUpdates(const std::string& body);
+    http_server::Response SendMessage(const std::string& body, bool error);
+
+    WorkloadSettings workload_;
+    std::function<void()> on_done_;
+    ZipfDistribution towns_;
+    std::uniform_int_distribution<uint32_t> chats_;
+    uint64_t sent_{};
+    uint64_t replied_{};
+    uint64_t reply_errors_{};
+    std::chrono::steady_clock::time_point started_{};
+    std::chrono::steady_clock::time_point finished_{};
+    std::unordered_map<int64_t, std::deque<std::chrono::steady_clock::time_point>> pending_; // чат -> время выдачи сообщений без ответа
+    metrics::Histogram reply_latency_;
+};
+
+class GeocodeStub : public Stub {
+public:
+    GeocodeStub(boost::asio::any_io_executor executor, StubBehavior behavior, WorkloadSettings workload);
+
+    boost::asio::awaitable<http_server::Response> Handle(http_server::Request req);
+
+private:
+    double not_found_rate_;
+};
+
+class ForecastStub : public Stub {
+public:
+    ForecastStub(boost::asio::any_io_executor executor, StubBehavior behavior, uint64_t seed);
+
+    boost::asio::awaitable<http_server::Response> Handle(http_server::Request req);
+    uint64_t Locations() const noexcept;    // запрошено точек
+
+private:
+    uint64_t locations_{};
+};
+
+}
@@ -1,50 +1,357 @@
 #include "logger.h"
 
-#include <boost/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <ctime>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace logger {
 
-const std::string GetTimeStampString() {
-    using namespace boost::posix_time;
+namespace {
+
+/* Ограниченная очередь Д. Вьюкова на кольцевом буфере: у каждой ячейки есть номер,
+ * по которому писатель определяет, что ячейка свободна, а читатель - что она заполнена.
+ * Писатели занимают ячейки через CAS позиции записи, читатель один и позицию чтения не разделяет.
+ * Строки в ячейках переиспользуются: после прогрева запись в буфер не выделяет память */
+class MpscRing {
+public:
+    explicit MpscRing(size_t capacity)
+        : slots_(std::bit_ceil(std::max<size_t>(capacity, 2)))
+        , mask_(slots_.size() - 1) {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool TryPush(std::string_view line) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Slot* slot{nullptr};
+        while (true) {
+            slot = &slots_[pos & mask_];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // буфер заполнен
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->line.assign(line);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Только для потока-читателя: передаёт запись в func и освобождает ячейку
+    template <typename Func>
+    bool TryConsume(Func&& func) {
+        Slot& slot = slots_[dequeue_pos_ & mask_];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeue_pos_ + 1) {
+            return false;
+        }
+        func(std::string_view(slot.line));
+        slot.sequence.store(dequeue_pos_ + slots_.size(), std::memory_order_release);
+        ++dequeue_pos_;
+        return true;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<size_t> sequence{};
+        std::string line;
+    };
+
+    std::vector<Slot> slots_;
+    const size_t mask_;
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) size_t dequeue_pos_{0};
+};
+
+std::atomic<uint64_t> dropped_total{0}; // отброшено записей при переполнении буфера
+std::atomic<Level> min_level{Level::info};
 
-    const size_t time_str_length = 26; // длина строки времени в ISO
-    std::string timestamp = to_iso_extended_string(microsec_clock::local_time());
-    if (timestamp.length() < time_str_length) {
-        timestamp += ".000000"; // для microsec_clock выводим дробную часть секунд, если она равна нулю
+std::string_view LevelName(Level level) noexcept {
+    switch (level) {
+    case Level::debug: return "debug";
+    case Level::info:  return "info";
+    case Level::warn:  return "warn";
+    case Level::error: return "error";
     }
+    return "info";
+}
+
+void Write(std::string_view line) {
+    BOOST_LOG_TRIVIAL(info) << line;
+}
+
+/* Фоновый вывод: поток ждёт новых записей на счётчике pushed_ (atomic wait),
+ * выводит до batch записей и сбрасывает приёмники (auto_flush в main отключён) */
+class AsyncBackend {
+public:
+    explicit AsyncBackend(LogSettings settings)
+        : settings_(settings)
+        , ring_(settings.capacity)
+        , flusher_([this] { FlushLoop(); }) {}
+
+    ~AsyncBackend() {
+        stop_.store(true, std::memory_order_release);
+        pushed_.fetch_add(1, std::memory_order_release);
+        pushed_.notify_one();
+        flusher_.join();
+    }
+
+    void Push(std::string_view line) {
+        while (!ring_.TryPush(line)) {
+            if (settings_.overflow == OverflowPolicy::drop) {
+                dropped_total.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            std::this_thread::yield();
+        }
+        pushed_.fetch_add(1, std::memory_order_release);
+        pushed_.notify_one();
+    }
+
+private:
+    void FlushLoop() {
+        uint64_t reported_dropped = dropped_total.load(std::memory_order_relaxed);
+        while (true) {
+            const uint64_t seen = pushed_.load(std::memory_order_acquire);
+            size_t written{0};
+            while (written < settings_.batch && ring_.TryConsume(Write)) {
+                ++written;
+            }
+            if (const uint64_t dropped = dropped_total.load(std::memory_order_relaxed); dropped != reported_dropped) {
+                ReportDropped(dropped - reported_dropped);
+                reported_dropped = dropped;
+                ++written;
+            }
+            if (written > 0) {
+                boost::log::core::get()->flush();
+                continue;
+            }
+            // буфер пуст: завершаемся только после вывода всех записей
+            if (stop_.load(std::memory_order_acquire)) {
+                return;
+            }
+            pushed_.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    static void ReportDropped(uint64_t count);
+
+    LogSettings settings_;
+    MpscRing ring_;
+    std::atomic<uint64_t> pushed_{0};
+    std::atomic<bool> stop_{false};
+    std::thread flusher_;
+};
+
+/* Состояние асинхронного режима. Писатели отмечаются в active_writers на время записи,
+ * StopAsync дожидается их, прежде чем остановить фоновый поток, поэтому записи не теряются
+ * (порядок store/load здесь важен, поэтому используется memory_order_seq_cst по умолчанию) */
+std::mutex backend_mutex;
+std::unique_ptr<AsyncBackend> backend;
+std::atomic<AsyncBackend*> active_backend{nullptr};
+std::atomic<uint64_t> active_writers{0};
+
+void AppendRecord(std::string& out, std::string_view text, std::string_view where, std::string_view message) {
+    out += R"({"timestamp":")";
+    util::AppendTimeStamp(out);
+    out += R"(","data":{"text":)";
+    util::AppendJsonString(out, text);
+    out += R"(,"where":)";
+    util::AppendJsonString(out, where);
+    out += R"(},"message":")";
+    out += message;
+    out += R"("})";
+}
+
+void Output(std::string_view text, std::string_view where, std::string_view message) {
+    thread_local std::string line;
+    line.clear();
+    AppendRecord(line, text, where, message);
+
+    ++active_writers;
+    if (AsyncBackend* async = active_backend.load()) {
+        async->Push(line);
+    } else {
+        Write(line);
+    }
+    --active_writers;
+}
+
+void AsyncBackend::ReportDropped(uint64_t count) {
+    std::string line;
+    AppendRecord(line, std::to_string(count) + " log records dropped: buffer overflow", "logger", "error");
+    Write(line);
+}
+
+}
+
+namespace util {
+
+void AppendJsonString(std::string& out, std::string_view text) {
+    constexpr static char HEX[]{"0123456789abcdef"};
+    out += '"';
+    for (const char ch : text) {
+        switch (ch) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        default:
+            if (static_cast<unsigned char>(ch) < 0x20) {
+                out += "\\u00";
+                out += HEX[(ch >> 4) & 0x0F];
+                out += HEX[ch & 0x0F];
+            } else {
+                out += ch;
+            }
+        }
+    }
+    out += '"';
+}
+
+/* Дата и время до секунд (localtime) пересчитываются не чаще раза в секунду на поток */
+void AppendTimeStamp(std::string& out) {
+    using namespace std::chrono;
+    thread_local int64_t cached_second{-1};
+    thread_local char cached_prefix[20]{}; // YYYY-MM-DDTHH:MM:SS
+
+    const auto now = system_clock::now();
+    const auto second = floor<seconds>(now);
+    const auto micros = duration_cast<microseconds>(now - second).count();
+    if (second.time_since_epoch().count() != cached_second) {
+        cached_second = second.time_since_epoch().count();
+        const time_t time = system_clock::to_time_t(second);
+        tm local{};
+#ifdef _WIN32
+        localtime_s(&local, &time);
+#else
+        localtime_r(&time, &local);
+#endif
+        std::strftime(cached_prefix, sizeof(cached_prefix), "%Y-%m-%dT%H:%M:%S", &local);
+    }
+    out.append(cached_prefix, 19);
+
+    char fraction[8]{'.', '0', '0', '0', '0', '0', '0'};
+    char digits[8]{};
+    const auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), micros);
+    const size_t size = static_cast<size_t>(end - digits);
+    std::copy(digits, end, fraction + 7 - size);
+    out.append(fraction, 7);
+}
+
+}
+
+const std::string GetTimeStampString() {
+    std::string timestamp;
+    util::AppendTimeStamp(timestamp);
     return timestamp;
 }
 
+std::string util::WithSuppressed(std::string_view text, uint64_t suppressed) {
+    std::string result(text);
+    result += " (";
+    result += std::to_string(suppressed);
+    result += " similar records suppressed)";
+    return result;
+}
+
+/* Окно - одна секунда steady_clock. Первый поток, заметивший новую секунду, сбрасывает счётчик;
+ * на границе окна возможна пара лишних записей, это допустимо */
+std::optional<uint64_t> RateLimiter::Allow() noexcept {
+    using namespace std::chrono;
+    const int64_t second = duration_cast<seconds>(steady_clock::now().time_since_epoch()).count();
+    int64_t window = window_.load(std::memory_order_relaxed);
+    if (window != second && window_.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+        count_.store(0, std::memory_order_relaxed);
+    }
+    if (count_.fetch_add(1, std::memory_order_relaxed) < per_second_) {
+        return suppressed_.exchange(0, std::memory_order_relaxed);
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+void SetLevel(Level level) noexcept {
+    min_level.store(level, std::memory_order_relaxed);
+}
+
+Level GetLevel() noexcept {
+    return min_level.load(std::memory_order_relaxed);
+}
+
+bool IsEnabled(Level level) noexcept {
+    return static_cast<int>(level) >= static_cast<int>(min_level.load(std::memory_order_relaxed));
+}
+
+void Log(Level level, const std::string_view text, const std::string_view where) {
+    if (IsEnabled(level)) {
+        Output(text, where, LevelName(level));
+    }
+}
+
 void LogError(const std::string_view error_text,
               const std::string_view where) {
-    boost::json::object res_obj;
-    res_obj["timestamp"] = GetTimeStampString();
-
-    boost::json::object data_obj;
-    data_obj["text"] = error_text;
-    data_obj["where"] = where;
+    Log(Level::error, error_text, where);
+}
 
-    res_obj["data"] = data_obj;
-    res_obj["message"] = "error";
-    boost::json::value val_json(res_obj);
-    BOOST_LOG_TRIVIAL(info) << boost::json::serialize(val_json);
+void LogWarn(const std::string_view warn_text,
+             const std::string_view where) {
+    Log(Level::warn, warn_text, where);
 }
 
 void LogInfo(const std::string_view info_text,
              const std::string_view where) {
-    boost::json::object res_obj;
-    res_obj["timestamp"] = GetTimeStampString();
+    Log(Level::info, info_text, where);
+}
 
-    boost::json::object data_obj;
-    data_obj["text"] = info_text;
-    data_obj["where"] = where;
+void LogDebug(const std::string_view debug_text,
+              const std::string_view where) {
+    Log(Level::debug, debug_text, where);
+}
 
-    res_obj["data"] = data_obj;
-    res_obj["message"] = "info";
-    boost::json::value val_json(res_obj);
-    BOOST_LOG_TRIVIAL(info) << boost::json::serialize(val_json);
+void StartAsync(LogSettings settings) {
+    std::lock_guard lock(backend_mutex);
+    if (backend) {
+        return;
+    }
+    backend = std::make_unique<AsyncBackend>(settings);
+    active_backend.store(backend.get());
 }
 
+void StopAsync() {
+    std::lock_guard lock(backend_mutex);
+    if (!backend) {
+        return;
+    }
+    active_backend.store(nullptr);
+    while (active_writers.load() != 0) {
+        std::this_thread::yield();
+    }
+    backend.reset(); // фоновый поток выводит оставшиеся записи и завершается
+    boost::log::core::get()->flush();
+}
+
+uint64_t Dropped() noexcept {
+    return dropped_total.load(std::memory_order_relaxed);
+}
 
 /* Функция принимает параметр типа record_view, содержащий полную информацию о сообщении,
  * и параметр типа formatting_ostream — поток, в который нужно вывести итоговый текст.
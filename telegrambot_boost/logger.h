@@ -1,6 +1,25 @@
 #pragma once
 /*
  * Функции вывода в лог
+ * Запись формируется сразу в виде строки JSON (без промежуточных json::object) в буфере потока
+ * После StartAsync записи передаются через кольцевой буфер (много писателей, один читатель)
+ * фоновому потоку, который пачками выводит их через Boost.Log и сбрасывает приёмники после каждой пачки:
+ * вызывающий поток не ждёт записи на диск. До StartAsync и после StopAsync записи выводятся сразу
+ *
+ * Уровни записей: debug, info, warn, error
+ * - LOGGER_MIN_LEVEL (0 - debug ... 3 - error, по умолчанию 1 - info) задаётся при сборке: вызовы макросов LOG_*
+ *   ниже этого уровня не компилируются в код, их аргументы не вычисляются
+ * - SetLevel задаёт порог во время работы
+ * - LOG_LIMITED ограничивает количество записей в секунду из одного места вызова, в очередную выведенную
+ *   запись добавляется количество пропущенных
+ *
+ * Использование:
+ *** boost::log::add_file_log(..., boost::log::keywords::auto_flush = false);
+ *** logger::StartAsync({.capacity = 16384, .overflow = logger::OverflowPolicy::drop});
+ *** logger::LogInfo("text", "where");
+ *** LOG_DEBUG("Connected to " + host, "HttpsClient::Connect");
+ *** LOG_LIMITED(logger::Level::error, 10, err.what(), "HttpsClient::Exchange"); // не более 10 записей в секунду
+ *** logger::StopAsync(); // выводит оставшиеся записи
  */
 #define BOOST_LOG_DYN_LINK 1
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -9,18 +28,117 @@
 #include <boost/log/utility/setup/common_attributes.hpp>
 #include <boost/log/utility/setup/console.hpp>
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <string_view>
 
+#ifndef LOGGER_MIN_LEVEL
+#define LOGGER_MIN_LEVEL 1
+#endif
+
 namespace logger {
 
+enum class Level : int {
+    debug = 0,
+    info = 1,
+    warn = 2,
+    error = 3
+};
+
+constexpr bool CompiledIn(Level level) noexcept {
+    return static_cast<int>(level) >= LOGGER_MIN_LEVEL;
+}
+
+// Поведение при переполнении кольцевого буфера
+enum class OverflowPolicy {
+    drop,   // запись отбрасывается (учитывается в Dropped), вызывающий поток не ждёт
+    block   // вызывающий поток ждёт, пока фоновый поток освободит место
+};
+
+struct LogSettings {
+    size_t capacity{8192};                      // размер кольцевого буфера (округляется вверх до степени двойки)
+    size_t batch{256};                          // максимальное количество записей между сбросами приёмников
+    OverflowPolicy overflow{OverflowPolicy::drop};
+};
+
+/* Ограничение частоты записей из одного места вызова: не более per_second записей в секунду
+ * Allow возвращает nullopt, если запись нужно пропустить, иначе - сколько записей пропущено с предыдущей */
+class RateLimiter {
+public:
+    explicit RateLimiter(uint32_t per_second) noexcept : per_second_(per_second) {}
+
+    std::optional<uint64_t> Allow() noexcept;
+
+private:
+    const uint32_t per_second_;
+    std::atomic<int64_t> window_{-1};       // текущая секунда
+    std::atomic<uint32_t> count_{0};        // записей в текущей секунде
+    std::atomic<uint64_t> suppressed_{0};
+};
+
 const std::string GetTimeStampString();
 
+void SetLevel(Level level) noexcept;
+Level GetLevel() noexcept;
+bool IsEnabled(Level level) noexcept;
+
+void Log(Level level, const std::string_view text, const std::string_view where);
 void LogError(const std::string_view error_text,
               const std::string_view where);
+void LogWarn(const std::string_view warn_text,
+             const std::string_view where);
 void LogInfo(const std::string_view info_text,
              const std::string_view where);
+void LogDebug(const std::string_view debug_text,
+              const std::string_view where);
+
+void StartAsync(LogSettings settings = {});
+void StopAsync();
+uint64_t Dropped() noexcept;    // количество записей, отброшенных при переполнении буфера
 
 void LogFormatter(boost::log::record_view const& rec, boost::log::formatting_ostream& strm);
 
+namespace util {
+// Добавление строки в out в виде строкового литерала JSON (в кавычках, с экранированием)
+void AppendJsonString(std::string& out, std::string_view text);
+// Добавление текущего локального времени в формате ISO 8601 с микросекундами: 2025-09-15T17:20:13.804124
+void AppendTimeStamp(std::string& out);
+// Текст записи с количеством пропущенных записей того же места вызова
+std::string WithSuppressed(std::string_view text, uint64_t suppressed);
 }
+
+}
+
+#define LOG_AT(level, text, where)                                      \
+    do {                                                                \
+        if constexpr (::logger::CompiledIn(level)) {                    \
+            if (::logger::IsEnabled(level)) {                           \
+                ::logger::Log(level, text, where);                      \
+            }                                                           \
+        }                                                               \
+    } while (false)
+
+#define LOG_DEBUG(text, where) LOG_AT(::logger::Level::debug, text, where)
+#define LOG_INFO(text, where) LOG_AT(::logger::Level::info, text, where)
+#define LOG_WARN(text, where) LOG_AT(::logger::Level::warn, text, where)
+#define LOG_ERROR(text, where) LOG_AT(::logger::Level::error, text, where)
+
+// У каждого места вызова свой RateLimiter (статическая переменная внутри блока)
+#define LOG_LIMITED(level, per_second, text, where)                                             \
+    do {                                                                                        \
+        if constexpr (::logger::CompiledIn(level)) {                                            \
+            if (::logger::IsEnabled(level)) {                                                   \
+                static ::logger::RateLimiter log_limiter_(per_second);                          \
+                if (const auto log_suppressed_ = log_limiter_.Allow()) {                        \
+                    if (*log_suppressed_ == 0) {                                                \
+                        ::logger::Log(level, text, where);                                      \
+                    } else {                                                                    \
+                        ::logger::Log(level, ::logger::util::WithSuppressed(text, *log_suppressed_), where); \
+                    }                                                                           \
+                }                                                                               \
+            }                                                                                   \
+        }                                                                                       \
+    } while (false)
@@ -0,0 +1,223 @@
+#pragma once
+/*
+ * Кэш с ограничением по количеству записей и по занимаемой памяти
+ * - при превышении ограничений удаляются давно не использованные записи (LRU)
+ * - записи старше ttl (с момента последней записи значения) считаются отсутствующими
+ * - ведётся статистика попаданий, промахов и вытеснений
+ * Не потокобезопасен. Указатели на значения действительны до удаления записи из кэша,
+ * поэтому в корутинах их нельзя сохранять через co_await
+ *
+ * Использование:
+ *** cache::LruCache<std::string, Info> cache({.max_entries = 1000, .max_bytes = 1 << 20},
+ ***                                         [](const std::string& key, const Info& info) { return info.Size(); });
+ *** cache.Put(key, info);
+ *** if (Info* info = cache.Get(key)) { ... }
+ */
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace cache {
+
+struct CacheSettings {
+    size_t max_entries{10000};              // максимальное количество записей
+    size_t max_bytes{0};                    // ограничение занимаемой памяти, 0 - без ограничения
+    std::chrono::seconds ttl{0};            // время жизни записи, 0 - без ограничения
+};
+
+struct CacheStats {
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t evictions{};                   // вытеснено из-за ограничений размера
+    uint64_t expirations{};                 // удалено по истечении ttl
+    size_t entries{};
+    size_t bytes{};
+};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        Key key;
+        Value value;
+        Clock::time_point stored;           // время последней записи значения
+        size_t bytes;
+    };
+    using List = std::list<Entry>;
+
+public:
+    // оценка памяти, занимаемой записью вне самого узла кэша (строки, векторы и т.п.)
+    using SizeFunc = std::function<size_t(const Key&, const Value&)>;
+
+    explicit LruCache(CacheSettings settings, SizeFunc size_func = {})
+        : settings_(settings)
+        , size_func_(std::move(size_func)) {}
+
+    // Поиск с учётом статистики, найденная запись становится самой "свежей"
+    Value* Get(const Key& key) {
+        auto it = Find(key);
+        if (it == entries_.end()) {
+            ++stats_.misses;
+            return nullptr;
+        }
+        ++stats_.hits;
+        entries_.splice(entries_.begin(), entries_, it);
+        return &it->value;
+    }
+
+    // Поиск без учёта статистики и без изменения порядка вытеснения
+    Value* Peek(const Key& key) {
+        auto it = Find(key);
+        return it == entries_.end() ? nullptr : &it->value;
+    }
+
+    bool Contains(const Key& key) {
+        return Find(key) != entries_.end();
+    }
+
+    // Добавление или замена записи, после чего при необходимости вытесняются старые записи
+    Value& Put(const Key& key, Value value) {
+        if (auto it = index_.find(key); it != index_.end()) {
+            it->second->value = std::move(value);
+            entries_.splice(entries_.begin(), entries_, it->second);
+        } else {
+            entries_.push_front(Entry{key, std::move(value), {}, 0});
+            index_.emplace(key, entries_.begin());
+        }
+        Account(entries_.front());
+        Evict();
+        return entries_.front().value;
+    }
+
+    /* Пересчёт размера записи и времени её записи после изменения значения по указателю
+     * Запись становится самой "свежей": только что обновлённые данные не должны вытесняться первыми */
+    void Update(const Key& key) {
+        if (auto it = index_.find(key); it != index_.end()) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            Account(entries_.front());
+            Evict();
+        }
+    }
+
+    /* Пересчёт только размера записи (например, после дополнения кэшированных данных), ttl записи не продлевается
+     * и порядок вытеснения не меняется, но сама запись при этом не вытесняется */
+    void Resize(const Key& key) {
+        if (auto it = index_.find(key); it != index_.end()) {
+            Measure(*it->second);
+            Evict(it->second);
+        }
+    }
+
+    bool Erase(const Key& key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return false;
+        }
+        Remove(it->second);
+        return true;
+    }
+
+    // Удаление всех записей с истёкшим ttl
+    void EvictExpired() {
+        if (settings_.ttl.count() == 0) {
+            return;
+        }
+        const auto now = Clock::now();
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            auto next = std::next(it);
+            if (now - it->stored > settings_.ttl) {
+                ++stats_.expirations;
+                Remove(it);
+            }
+            it = next;
+        }
+    }
+
+    // Обход всех записей (от самой "свежей" к самой старой), func(const Key&, Value&)
+    template <typename Func>
+    void ForEach(Func func) {
+        for (auto& entry : entries_) {
+            func(entry.key, entry.value);
+        }
+    }
+
+    CacheStats GetStats() const noexcept {
+        CacheStats stats = stats_;
+        stats.entries = entries_.size();
+        stats.bytes = bytes_;
+        return stats;
+    }
+
+    size_t Size() const noexcept {
+        return entries_.size();
+    }
+
+private:
+    // накладные расходы на узел списка и индекса
+    constexpr static size_t NODE_OVERHEAD{sizeof(Entry) + sizeof(Key) + 6 * sizeof(void*)};
+
+    typename List::iterator Find(const Key& key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return entries_.end();
+        }
+        if (settings_.ttl.count() != 0 && Clock::now() - it->second->stored > settings_.ttl) {
+            ++stats_.expirations;
+            Remove(it->second);
+            return entries_.end();
+        }
+        return it->second;
+    }
+
+    void Account(Entry& entry) {
+        Measure(entry);
+        entry.stored = Clock::now();
+    }
+
+    void Measure(Entry& entry) {
+        bytes_ -= entry.bytes;
+        entry.bytes = NODE_OVERHEAD + (size_func_ ? size_func_(entry.key, entry.value) : 0);
+        bytes_ += entry.bytes;
+    }
+
+    // Вытеснение самых старых записей, самая "свежая" запись и запись keep не вытесняются
+    void Evict() {
+        Evict(entries_.begin());
+    }
+
+    void Evict(typename List::iterator keep) {
+        while (entries_.size() > settings_.max_entries ||
+               (settings_.max_bytes != 0 && bytes_ > settings_.max_bytes)) {
+            auto oldest = std::prev(entries_.end());
+            if (oldest == keep && oldest != entries_.begin()) {
+                oldest = std::prev(oldest);
+            }
+            if (oldest == entries_.begin()) {
+                break;
+            }
+            ++stats_.evictions;
+            Remove(oldest);
+        }
+    }
+
+    void Remove(typename List::iterator it) {
+        bytes_ -= it->bytes;
+        index_.erase(it->key);
+        entries_.erase(it);
+    }
+
+    CacheSettings settings_;
+    SizeFunc size_func_;
+    List entries_;                                                  // от самой "свежей" к самой старой
+    std::unordered_map<Key, typename List::iterator, Hash> index_;
+    size_t bytes_{};
+    CacheStats stats_;
+};
+
+}
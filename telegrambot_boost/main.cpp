@@ -1,42 +1,74 @@
 /*
  * Погодный телеграмм бот
  * - телеграмм бот выполняется асинхронно
- * - запросы погоды в городах выполняются синхронно
- * - логируются: ошибки и подключение/отключение от сетевых ресурсов
- *
- * TODO:
- * 1) Сделать асинхронными запросы погоды
+ * - запросы погоды в городах выполняются асинхронно в том же io_context
+ * - логируются: ошибки (частые ошибки одного места - не более 10 записей в секунду) и события запуска;
+ *   подключение/отключение от сетевых ресурсов - на уровне debug
+ * - метрики в формате Prometheus отдаются по адресу http://127.0.0.1:9100/metrics
+ * - трассы обработки сообщений (выборка и все медленные) пишутся в trace.json в формате Chrome trace event
  */
+#include "asyncutil.h"
+#include "httpserver.h"
+#include "httpspool.h"
 #include "logger.h"
 #include "meteobot.h"
+#include "metrics.h"
 #include "telegrambot.h"
+#include "tracing.h"
 
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <boost/log/utility/setup/file.hpp>
+#include <chrono>
 #include <csignal>
 #include <ios>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 
 using namespace std::string_literals;
 
 struct WeatherGet {
-    std::string operator()(std::string&& town) {
-        return bot->GetWeather(std::move(town));
+    boost::asio::awaitable<telega::ReplyPtr> operator()(std::string town, tracing::TracePtr trace) {
+        co_return co_await bot->GetWeather(std::move(town), std::move(trace));
     }
 
     std::shared_ptr<meteo::MeteoBot> bot;
 };
 
+// Выдача метрик на GET /metrics, остальные запросы - 404
+boost::asio::awaitable<http_server::Response> MetricsHandler(http_server::Request req) {
+    namespace http = boost::beast::http;
+    if (req.method() != http::verb::get || std::string_view(req.target()) != "/metrics") {
+        co_return http_server::MakeResponse(http::status::not_found);
+    }
+    co_return http_server::MakeResponse(http::status::ok, metrics::Global().Serialize(),
+                                        "text/plain; version=0.0.4; charset=utf-8");
+}
+
 int main() {
     const std::string telegramm_token{"here_must_be_your_telegram_bot_token"};
 
+    // сервер метрик без TLS, доступен только с локального адреса
+    const http_server::ServerSettings metrics_settings{.address = "127.0.0.1", .port = 9100};
+
+    // true - обновления принимаются встроенным сервером (webhook), false - long polling getUpdates
+    const bool use_webhook{false};
+    const telega::WebhookSettings webhook_settings{
+        .url = "https://here_must_be_your_host:8443/webhook",
+        .path = "/webhook",
+        .secret_token = "here_must_be_your_webhook_secret",
+        .server = {.address = "0.0.0.0",
+                   .port = 8443,
+                   .cert_file = "webhook_cert.pem",
+                   .key_file = "webhook_key.pem"}
+    };
+
     boost::log::add_console_log(
         std::clog,
         boost::log::keywords::format = &(logger::LogFormatter),
-        boost::log::keywords::auto_flush = true
+        boost::log::keywords::auto_flush = false
     );
 
     boost::log::add_file_log(
@@ -45,23 +77,66 @@ int main() {
         boost::log::keywords::open_mode = std::ios_base::app | std::ios_base::out,
         boost::log::keywords::rotation_size = 10 * 1024 * 1024,
         boost::log::keywords::time_based_rotation = boost::log::sinks::file::rotation_at_time_point(12, 0, 0),
-        boost::log::keywords::auto_flush = true
+        boost::log::keywords::auto_flush = false
     );
+    // приёмники сбрасывает фоновый поток логгера после каждой пачки записей
+    // вызовы LOG_DEBUG исключаются при сборке (LOGGER_MIN_LEVEL), порог ниже задаётся во время работы
+    logger::SetLevel(logger::Level::info);
+    logger::StartAsync({.capacity = 16384, .batch = 256, .overflow = logger::OverflowPolicy::drop});
+    tracing::Start({.file = "trace.json", .sample_every = 100, .slow_threshold = std::chrono::seconds{2}});
 
     boost::asio::io_context ioc;
 
-    boost::asio::signal_set signal_set(ioc, SIGINT, SIGTERM);
-    signal_set.async_wait([&ioc](const boost::system::error_code& ec, [[maybe_unused]] int signal_number) {
-        if (!ec) {
-            ioc.stop();
-        }
-    });
+    // общий пул подключений для telegram, open-meteo и geocode
+    auto pool = std::make_shared<https_pool::HttpsPool>(ioc.get_executor(),
+                                                        https_pool::PoolSettings{.max_connections = 16,
+                                                                                 .idle_timeout = std::chrono::seconds{50}});
 
     try {
+        meteo::MeteoSettings meteo_settings{
+            .batch = {.window = std::chrono::milliseconds{5}, .max_locations = 50},
+            .refresh = {.top_towns = 50},
+            .gazetteer_file = "gazetteer.bin",
+            .snapshot_file = "meteo_snapshot.bin",
+            .snapshot_period = std::chrono::minutes{5},
+            .grid_resolution = 0.1,
+            .forecast_cache = {.max_entries = 20000, .max_bytes = 64 * 1024 * 1024, .ttl = std::chrono::hours{24}},
+            .town_cache = {.max_entries = 100000, .max_bytes = 32 * 1024 * 1024, .ttl = std::chrono::hours{24 * 7}}};
+        auto meteo_bot = std::make_shared<meteo::MeteoBot>(ioc.get_executor(), pool, meteo_settings);
+        meteo_bot->LoadSnapshot();
+
+        /* При завершении бот перестаёт получать обновления и отвечает на уже полученные (контрольная точка
+         * смещения getUpdates сдвигается только по отвеченным), затем сохраняем итоговый снимок кэшей,
+         * чтобы после перезапуска не запрашивать всё заново, и останавливаем io_context */
+        auto stop = std::make_shared<async_util::Event>(ioc.get_executor());
+        boost::asio::signal_set signal_set(ioc, SIGINT, SIGTERM);
+        signal_set.async_wait([stop](const boost::system::error_code& ec, [[maybe_unused]] int signal_number) {
+            if (!ec) {
+                stop->Set();
+            }
+        });
+
+        http_server::HttpServer metrics_server(ioc.get_executor(), metrics_settings, MetricsHandler);
+        boost::asio::co_spawn(ioc, metrics_server.Run(), boost::asio::detached);
+
+        boost::asio::co_spawn(ioc, meteo_bot->RunRefresh(), boost::asio::detached);
+        boost::asio::co_spawn(ioc, meteo_bot->RunSnapshots(), boost::asio::detached);
+        WeatherGet weather_get{meteo_bot};
         boost::asio::co_spawn(ioc,
-                              telega::RunTelegramBot(telegramm_token,
-                                                     WeatherGet{std::make_shared<meteo::MeteoBot>(ioc)}),
-                              [](std::exception_ptr err) {
+                              use_webhook ?
+                                  telega::RunTelegramWebhook(telegramm_token, weather_get, pool, webhook_settings, stop) :
+                                  telega::RunTelegramBot(telegramm_token,
+                                                         weather_get,
+                                                         pool,
+                                                         telega::PollSettings{.timeout = 25,
+                                                                              .limit = 100,
+                                                                              .allowed_updates = {"message"},
+                                                                              .offset_file = "telegram_offset.txt"},
+                                                         telega::ReplySettings{.max_parallel = 64},
+                                                         stop),
+                              [&ioc, meteo_bot](std::exception_ptr err) {
+                                  meteo_bot->SaveSnapshot();
+                                  ioc.stop();
                                   if(err) {
                                       std::rethrow_exception(err);
                                   }
@@ -70,8 +145,12 @@ int main() {
 
     } catch(const std::exception& err) {
         logger::LogError(err.what(), "main");
+        tracing::Stop();
+        logger::StopAsync();
         return EXIT_FAILURE;
     }
 
+    tracing::Stop();
+    logger::StopAsync();
     return EXIT_SUCCESS;
 }
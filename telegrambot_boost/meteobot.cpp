@@ -1,185 +1,1244 @@
 #include "logger.h"
 #include "meteobot.h"
+#include "metrics.h"
+#include "numscan.h"
 
-#include <boost/algorithm/string.hpp>
-#include <boost/algorithm/string/trim_all.hpp>
-#include <boost/url/encode.hpp>
-#include <boost/url/rfc/pchars.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/json/basic_parser_impl.hpp>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <cmath>
+#include <cstring>
+#include <deque>
+#include <filesystem>
 #include <format>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
 
 namespace meteo {
 
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace json = boost::json;
+namespace bip = boost::interprocess;
 
 using namespace std::chrono;
 
+namespace {
+
+// Ответы из кэша прогнозов и время обновления прогноза для ячейки сетки
+struct WeatherMetrics {
+    metrics::Counter& fresh;
+    metrics::Counter& stale;
+    metrics::Counter& miss;
+    metrics::Counter& errors;
+    metrics::Histogram& update_latency;
+    metrics::Counter& reply_hit;
+    metrics::Counter& reply_miss;
+};
+
+const WeatherMetrics& Metrics() {
+    constexpr static char REQUESTS[]{"bot_weather_requests_total"};
+    auto& registry = metrics::Global();
+    static const WeatherMetrics weather_metrics{
+        registry.GetCounter(REQUESTS, R"(cache="fresh")", "Weather requests by forecast cache state"),
+        registry.GetCounter(REQUESTS, R"(cache="stale")"),
+        registry.GetCounter(REQUESTS, R"(cache="miss")"),
+        registry.GetCounter("bot_weather_errors_total", "", "Weather requests answered with an error"),
+        registry.GetHistogram("bot_forecast_update_seconds", "", "Forecast update latency for a grid cell"),
+        registry.GetCounter("bot_reply_cache_total", R"(result="hit")", "Weather replies taken from the reply cache"),
+        registry.GetCounter("bot_reply_cache_total", R"(result="miss")")
+    };
+    return weather_metrics;
+}
+
+// "2025-01-01T03:00" -> секунды от начала эпохи без учёта часового пояса
+std::optional<int64_t> ParseIsoTime(std::string_view text) {
+    if (text.size() < 16 || text[4] != '-' || text[7] != '-' || text[10] != 'T' || text[13] != ':') {
+        return std::nullopt;
+    }
+    const auto number = [text](size_t pos, size_t len) {
+        int value{-1};
+        const auto [ptr, ec] = std::from_chars(text.data() + pos, text.data() + pos + len, value);
+        return ec == std::errc{} && ptr == text.data() + pos + len ? value : -1;
+    };
+    const int hours = number(11, 2);
+    const int minutes = number(14, 2);
+    const year_month_day date{year{number(0, 4)}, month{static_cast<unsigned>(number(5, 2))},
+                              day{static_cast<unsigned>(number(8, 2))}};
+    if (!date.ok() || hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+        return std::nullopt;
+    }
+    return duration_cast<seconds>(sys_days{date}.time_since_epoch()).count() + hours * 3600 + minutes * 60;
+}
+
+/* Значения прогноза одной точки по мере разбора (общая часть потокового разбора и разбора дерева JSON)
+ * Время приходит в unix time (timeformat=unixtime) или строками ISO 8601 в часовом поясе прогноза,
+ * по первым двум значениям определяются начало и шаг. Массивы переиспользуются для всех точек ответа */
+struct ForecastParts {
+    Units units{};
+    int32_t utc_offset{};
+    bool time_seen{false};      // был массив time: прогноз действителен
+    bool time_local{false};     // время строками ISO 8601 (местное)
+    bool time_error{false};
+    size_t time_count{};
+    int64_t time_start{};
+    int64_t time_step{};
+    std::vector<float> values[Forecast::VARIABLES];
+
+    void Reset() {
+        units = *DefaultUnits();
+        utc_offset = 0;
+        ResetTime();
+        for (auto& variable : values) {
+            variable.clear();
+        }
+    }
+
+    void ResetTime() {
+        time_seen = true;
+        time_local = false;
+        time_error = false;
+        time_count = 0;
+        time_start = 0;
+        time_step = 0;
+    }
+
+    std::vector<float>& Values(Forecast::Variable variable) {
+        return values[static_cast<size_t>(variable)];
+    }
+
+    void AddTime(int64_t time) {
+        if (time_count == 0) {
+            time_start = time;
+        } else if (time_count == 1) {
+            time_step = time - time_start;
+        }
+        ++time_count;
+    }
+
+    void AddTime(std::string_view iso) {
+        const auto time = ParseIsoTime(iso);
+        time_local = true;
+        if (!time) {
+            time_error = true;
+            return;
+        }
+        AddTime(*time);
+    }
+
+    // Лишние значения отбрасываются, недостающие остаются NaN
+    void Finish(MeteoInfo& info) const {
+        info.units = InternUnits(units);
+        if (!time_seen || time_error || time_step < 0 || time_step > std::numeric_limits<int32_t>::max()) {
+            return;
+        }
+        Forecast forecast(time_local ? time_start - utc_offset : time_start, static_cast<int32_t>(time_step),
+                          utc_offset, time_count);
+        for (size_t i = 0; i < Forecast::VARIABLES; ++i) {
+            auto target = forecast.Values(static_cast<Forecast::Variable>(i));
+            std::copy_n(values[i].begin(), std::min(values[i].size(), target.size()), target.begin());
+        }
+        info.forecast = std::move(forecast);
+        info.updated_time = system_clock::now();
+        info.valid = true;
+    }
+};
+
+/* Обработчик json::basic_parser для ответа open-meteo: значения собираются в ForecastParts и по завершении
+ * объекта точки переносятся в один блок Forecast, дерево JSON не строится.
+ * Ответ - объект (одна точка) или массив объектов (пакет точек)
+ * Массивы ForecastParts общие для всех точек и резервируются по ожидаемому количеству значений,
+ * поэтому число выделений памяти не зависит от длины прогноза */
+class ForecastHandler {
+    enum class Section { none, hourly, units };
+    enum class Field { none, time, temperature, rain, snowfall };
+
+public:
+    constexpr static size_t max_object_size = static_cast<size_t>(-1);
+    constexpr static size_t max_array_size = static_cast<size_t>(-1);
+    constexpr static size_t max_key_size = static_cast<size_t>(-1);
+    constexpr static size_t max_string_size = static_cast<size_t>(-1);
+
+    ForecastHandler(std::vector<MeteoInfo>& weather, size_t expected_points)
+        : weather_(weather)
+        , points_hint_(expected_points) {}
+
+    bool on_document_begin(boost::system::error_code&) { return true; }
+    bool on_document_end(boost::system::error_code&) { return true; }
+
+    bool on_object_begin(boost::system::error_code&) {
+        awaiting_value_ = false;
+        if (depth_ == 0) {
+            location_depth_ = 1;
+        }
+        Nested();
+        ++depth_;
+        if (depth_ == location_depth_) {
+            weather_.emplace_back();
+            parts_.Reset();
+            parts_.time_seen = false;
+        } else if (depth_ == location_depth_ + 1) {
+            section_ = pending_section_;
+        }
+        return true;
+    }
+
+    bool on_object_end(size_t, boost::system::error_code&) {
+        if (depth_ == location_depth_) {
+            parts_.Finish(weather_.back());
+        } else if (depth_ == location_depth_ + 1) {
+            section_ = Section::none;
+            field_ = Field::none;
+        }
+        --depth_;
+        return true;
+    }
+
+    bool on_array_begin(boost::system::error_code&) {
+        awaiting_value_ = false;
+        if (depth_ == 0) {
+            location_depth_ = 2;
+        } else {
+            Element();
+            Nested();
+        }
+        ++depth_;
+        if (depth_ == location_depth_ + 2 && section_ == Section::hourly) {
+            BeginValues();
+        }
+        return true;
+    }
+
+    bool on_array_end(size_t, boost::system::error_code&) {
+        if (depth_ == location_depth_ + 2 && field_ != Field::none) {
+            points_hint_ = std::max(points_hint_, values_ ? values_->size() : parts_.time_count);
+            values_ = nullptr;
+            field_ = Field::none;
+        }
+        --depth_;
+        return true;
+    }
+
+    bool on_key_part(std::string_view part, size_t, boost::system::error_code&) {
+        buffer_ += part;
+        return true;
+    }
+
+    bool on_key(std::string_view key, size_t, boost::system::error_code&) {
+        key = Complete(key);
+        if (depth_ == location_depth_) {
+            pending_section_ = key == "hourly" ? Section::hourly
+                             : key == "hourly_units" ? Section::units
+                             : Section::none;
+            utc_offset_key_ = key == "utc_offset_seconds";
+        } else if (depth_ == location_depth_ + 1) {
+            field_ = section_ == Section::none ? Field::none
+                   : key == "time" ? Field::time
+                   : key == "temperature_2m" ? Field::temperature
+                   : key == "rain" ? Field::rain
+                   : key == "snowfall" ? Field::snowfall
+                   : Field::none;
+        }
+        buffer_.clear();
+        awaiting_value_ = true;
+        return true;
+    }
+
+    bool on_string_part(std::string_view part, size_t, boost::system::error_code&) {
+        awaiting_value_ = false;
+        buffer_ += part;
+        return true;
+    }
+
+    bool on_string(std::string_view text, size_t, boost::system::error_code&) {
+        awaiting_value_ = false;
+        Element();
+        text = Complete(text);
+        if (depth_ == location_depth_ + 2 && field_ == Field::time) {
+            parts_.AddTime(text);
+        } else if (depth_ == location_depth_ + 2) {
+            Number(std::numeric_limits<float>::quiet_NaN());    // строка в массиве чисел - нет данных, как и null
+        } else if (depth_ == location_depth_ + 1 && section_ == Section::units) {
+            auto& units = parts_.units;
+            switch (field_) {
+            case Field::time: units.time_format = text; break;
+            case Field::temperature: units.temperature = text; break;
+            case Field::rain: units.rain = text; break;
+            case Field::snowfall: units.snowfall = text; break;
+            case Field::none: break;
+            }
+        }
+        buffer_.clear();
+        return true;
+    }
+
+    bool on_number_part(std::string_view, boost::system::error_code&) {
+        awaiting_value_ = false;
+        return true;
+    }
+    bool on_int64(int64_t value, std::string_view, boost::system::error_code&) { return Integer(value); }
+    bool on_uint64(uint64_t value, std::string_view, boost::system::error_code&) { return Integer(static_cast<int64_t>(value)); }
+    bool on_double(double value, std::string_view, boost::system::error_code&) { return Number(static_cast<float>(value)); }
+    bool on_bool(bool, boost::system::error_code&) { return Number(std::numeric_limits<float>::quiet_NaN()); }
+    // null - нет данных на этот час
+    bool on_null(boost::system::error_code&) { return Number(std::numeric_limits<float>::quiet_NaN()); }
+    bool on_comment_part(std::string_view, boost::system::error_code&) { return true; }
+    bool on_comment(std::string_view, boost::system::error_code&) { return true; }
+
+    /* Массив чисел прогноза, значением которого будет следующий символ '[' (ключ уже разобран)
+     * ParseForecast разбирает такие массивы сам и передаёт парсеру вместо них пустой массив */
+    std::vector<float>* NumericTarget() noexcept {
+        if (!awaiting_value_ || section_ != Section::hourly || depth_ != location_depth_ + 1) {
+            return nullptr;
+        }
+        switch (field_) {
+        case Field::temperature: return &parts_.Values(Forecast::Variable::temperature);
+        case Field::rain: return &parts_.Values(Forecast::Variable::rain);
+        case Field::snowfall: return &parts_.Values(Forecast::Variable::snowfall);
+        default: return nullptr;
+        }
+    }
+
+private:
+    // Не объект в массиве пакета - точка без прогноза
+    void Element() {
+        if (location_depth_ == 2 && depth_ == 1) {
+            weather_.emplace_back();
+        }
+    }
+
+    // Вложенный массив или объект в массиве прогноза - нет данных на этот час (значения внутри не учитываются)
+    void Nested() {
+        if (depth_ == location_depth_ + 2) {
+            Number(std::numeric_limits<float>::quiet_NaN());
+        }
+    }
+
+    // Строка или ключ, пришедшие частями, собираются в buffer_
+    std::string_view Complete(std::string_view last) {
+        if (buffer_.empty()) {
+            return last;
+        }
+        buffer_ += last;
+        return buffer_;
+    }
+
+    void BeginValues() {
+        switch (field_) {
+        case Field::time: parts_.ResetTime(); return;
+        case Field::temperature: values_ = &parts_.Values(Forecast::Variable::temperature); break;
+        case Field::rain: values_ = &parts_.Values(Forecast::Variable::rain); break;
+        case Field::snowfall: values_ = &parts_.Values(Forecast::Variable::snowfall); break;
+        case Field::none: return;
+        }
+        values_->clear();
+        values_->reserve(points_hint_);
+    }
+
+    bool Integer(int64_t value) {
+        if (depth_ == location_depth_ + 2 && field_ == Field::time) {
+            awaiting_value_ = false;
+            parts_.AddTime(value);
+            return true;
+        }
+        if (depth_ == location_depth_ && utc_offset_key_) {
+            parts_.utc_offset = static_cast<int32_t>(value);
+        }
+        return Number(static_cast<float>(value));
+    }
+
+    bool Number(float value) {
+        awaiting_value_ = false;
+        Element();
+        if (values_ && depth_ == location_depth_ + 2) {
+            values_->push_back(value);
+        }
+        return true;
+    }
+
+    std::vector<MeteoInfo>& weather_;
+    size_t points_hint_;                // ожидаемое количество значений в массиве прогноза
+    size_t depth_{};                    // количество открытых объектов и массивов
+    size_t location_depth_{1};          // глубина объекта точки: 1 - ответ-объект, 2 - ответ-массив
+    Section pending_section_{Section::none};
+    Section section_{Section::none};
+    Field field_{Field::none};
+    bool utc_offset_key_{false};        // последний ключ точки - utc_offset_seconds
+    ForecastParts parts_;
+    std::vector<float>* values_{};      // заполняемый массив прогноза
+    bool awaiting_value_{false};        // последним разобран ключ, значение ещё не началось
+    std::string buffer_;
+};
+
+std::mutex units_mutex;
+std::deque<Units> units_table;  // защищена units_mutex, элементы не удаляются
+
+}
+
+/* -------- Units -------- */
+
+const Units* InternUnits(const Units& units) {
+    std::lock_guard lock(units_mutex);
+    for (const auto& interned : units_table) {
+        if (interned == units) {
+            return &interned;
+        }
+    }
+    return &units_table.emplace_back(units);
+}
+
+const Units* DefaultUnits() noexcept {
+    static const Units* const default_units = InternUnits(Units{});
+    return default_units;
+}
+
 namespace util {
 MeteoInfo ResponseProcess(const boost::json::object& msg) {
     const std::string hourly_units_obj_str{"hourly_units"};
     const std::string hourly_obj_str{"hourly"};
+    const std::string utc_offset_val_str{"utc_offset_seconds"};
 
     const std::string time_val_str{"time"};
     const std::string temperature_val_str{"temperature_2m"};
     const std::string rain_val_str{"rain"};
     const std::string snowfall_val_str{"snowfall"};
     MeteoInfo weather{};
+    ForecastParts parts;
+    parts.Reset();
+    parts.time_seen = false;
 
+    const auto read_values = [](const json::array& vals, std::vector<float>& values) {
+        values.reserve(vals.size());
+        for (const auto& val : vals) {
+            // null и не числа (как и в потоковом разборе) - нет данных
+            values.push_back(val.is_number() ? static_cast<float>(val.to_number<double>()) : std::numeric_limits<float>::quiet_NaN());
+        }
+    };
+
+    if (msg.contains(utc_offset_val_str) && msg.at(utc_offset_val_str).is_number()) {
+        parts.utc_offset = msg.at(utc_offset_val_str).to_number<int32_t>();
+    }
     if (msg.contains(hourly_obj_str) && msg.at(hourly_obj_str).is_object()) {
-        auto forecast_obj = msg.at(hourly_obj_str).as_object();
+        const auto& forecast_obj = msg.at(hourly_obj_str).as_object();
         if (forecast_obj.contains(time_val_str) && forecast_obj.at(time_val_str).is_array()) {
-            auto vals = forecast_obj.at(time_val_str).as_array();
-            weather.forecast.time.clear();
-            for (auto val : vals) {
-                weather.forecast.time.emplace_back(std::string(val.as_string()));
+            parts.ResetTime();
+            for (const auto& val : forecast_obj.at(time_val_str).as_array()) {
+                if (val.is_string()) {
+                    parts.AddTime(std::string_view(val.as_string()));
+                } else {
+                    parts.AddTime(val.to_number<int64_t>());
+                }
             }
-            weather.updated_time = system_clock::now();
-            weather.valid = true;
         }
         if (forecast_obj.contains(temperature_val_str) && forecast_obj.at(temperature_val_str).is_array()) {
-            auto vals = forecast_obj.at(temperature_val_str).as_array();
-            weather.forecast.temperature.clear();
-            for (auto val : vals) {
-                weather.forecast.temperature.push_back(static_cast<float>(val.as_double()));
-            }
+            read_values(forecast_obj.at(temperature_val_str).as_array(), parts.Values(Forecast::Variable::temperature));
         }
         if (forecast_obj.contains(rain_val_str) && forecast_obj.at(rain_val_str).is_array()) {
-            auto vals = forecast_obj.at(rain_val_str).as_array();
-            weather.forecast.rain.clear();
-            for (auto val : vals) {
-                weather.forecast.rain.push_back(static_cast<float>(val.as_double()));
-            }
+            read_values(forecast_obj.at(rain_val_str).as_array(), parts.Values(Forecast::Variable::rain));
         }
         if (forecast_obj.contains(snowfall_val_str) && forecast_obj.at(snowfall_val_str).is_array()) {
-            auto vals = forecast_obj.at(snowfall_val_str).as_array();
-            weather.forecast.snowfall.clear();
-            for (auto val : vals) {
-                weather.forecast.snowfall.push_back(static_cast<float>(val.as_double()));
-            }
+            read_values(forecast_obj.at(snowfall_val_str).as_array(), parts.Values(Forecast::Variable::snowfall));
         }
     }
 
     if (msg.contains(hourly_units_obj_str) && msg.at(hourly_units_obj_str).is_object()) {
-        auto units_obj = msg.at(hourly_obj_str).as_object();
+        const auto& units_obj = msg.at(hourly_units_obj_str).as_object();
         if (units_obj.contains(time_val_str) && units_obj.at(time_val_str).is_string()) {
-            weather.units.time_format = units_obj.at(time_val_str).as_string();
+            parts.units.time_format = units_obj.at(time_val_str).as_string();
         }
         if (units_obj.contains(temperature_val_str) && units_obj.at(temperature_val_str).is_string()) {
-            weather.units.temperature = units_obj.at(temperature_val_str).as_string();
+            parts.units.temperature = units_obj.at(temperature_val_str).as_string();
         }
         if (units_obj.contains(rain_val_str) && units_obj.at(rain_val_str).is_string()) {
-            weather.units.rain = units_obj.at(rain_val_str).as_string();
+            parts.units.rain = units_obj.at(rain_val_str).as_string();
         }
         if (units_obj.contains(snowfall_val_str) && units_obj.at(snowfall_val_str).is_string()) {
-            weather.units.snowfall = units_obj.at(snowfall_val_str).as_string();
+            parts.units.snowfall = units_obj.at(snowfall_val_str).as_string();
         }
     }
+    parts.Finish(weather);
     return weather;
 }
+
+/* Прогноз записывается как есть: начало, шаг, смещение часового пояса, размер и блок значений */
+void SerializeForecast(file_util::BinaryWriter& writer, const MeteoInfo& info) {
+    writer.Put<int64_t>(duration_cast<milliseconds>(info.updated_time.time_since_epoch()).count());
+    writer.Put<uint8_t>(info.valid);
+    writer.Put<uint64_t>(info.hits);
+    writer.PutString(info.units->time_format);
+    writer.PutString(info.units->temperature);
+    writer.PutString(info.units->rain);
+    writer.PutString(info.units->snowfall);
+    const Forecast& forecast = info.forecast;
+    writer.Put<int64_t>(forecast.Start());
+    writer.Put<int32_t>(forecast.Step());
+    writer.Put<int32_t>(forecast.UtcOffset());
+    writer.Put<uint32_t>(static_cast<uint32_t>(forecast.Size()));
+    const auto block = forecast.Block();
+    writer.PutBytes({reinterpret_cast<const char*>(block.data()), block.size_bytes()});
 }
 
-/* -------- MeteoBot -------- */
+// Координаты не сохраняются: они определяются ячейкой сетки
+MeteoInfo DeserializeForecast(file_util::BinaryReader& reader) {
+    MeteoInfo info;
+    info.updated_time = TimePoint{milliseconds{reader.Get<int64_t>()}};
+    info.valid = reader.Get<uint8_t>() != 0;
+    info.hits = reader.Get<uint64_t>();
+    Units units;
+    units.time_format = reader.GetString();
+    units.temperature = reader.GetString();
+    units.rain = reader.GetString();
+    units.snowfall = reader.GetString();
+    info.units = InternUnits(units);
+    const int64_t start = reader.Get<int64_t>();
+    const int32_t step = reader.Get<int32_t>();
+    const int32_t utc_offset = reader.Get<int32_t>();
+    const uint32_t size = reader.Get<uint32_t>();
+    // размер из файла проверяется до выделения памяти: повреждённый снимок не должен приводить к огромному выделению
+    const uint64_t block_bytes = uint64_t{size} * Forecast::VARIABLES * sizeof(float);
+    if (block_bytes > reader.Remaining()) {
+        throw std::out_of_range(std::format("Forecast size {} exceeds snapshot data", size));
+    }
+    info.forecast = Forecast(start, step, utc_offset, size);
+    if (size != 0) {
+        const auto block = info.forecast.Block();
+        std::memcpy(block.data(), reader.GetBytes(block.size_bytes()).data(), block.size_bytes());
+    }
+    return info;
+}
 
-MeteoBot::MeteoBot(boost::asio::io_context& ioc)
-    : client_(std::make_unique<https_sync::HttpsSyncClient>(ioc))
-    , geocode_(std::make_unique<geo::Geocode>(ioc)) {}
+/* Справочник необязателен: если файл не задан или не открылся, бот работает только с geocode */
+std::shared_ptr<const gazetteer::Gazetteer> LoadGazetteer(const std::string& file_name) {
+    if (file_name.empty()) {
+        return nullptr;
+    }
+    try {
+        auto places = std::make_shared<const gazetteer::Gazetteer>(file_name);
+        logger::LogInfo(std::format("Gazetteer {} loaded: {} names, {} places",
+                                    file_name, places->Names(), places->Places()),
+                        "MeteoBot. LoadGazetteer");
+        return places;
+    } catch (const std::exception& err) {
+        logger::LogError(err.what(), "MeteoBot. LoadGazetteer");
+        return nullptr;
+    }
+}
 
-/* Получаем погоду для запрошенного города
- * 1) строку с городом очищаем от лишних пробелов и приводим все буквы к строчным
- * 2) производим url encode строки с запрошенным городом, в дальнейшем будем работать только с ней
- * 3) если для запрошенного города координат ещё не запрашивали, то запрашиваем координаты города в Geocode
- *      - если города не существует (не найден в geocode) используем город по умолчанию
- * 4) получаем погоду для запрошенного города:
- *      - если погода для города ещё не получена или если данные устарели, обновляем погодные данные для города */
-std::string MeteoBot::GetWeather(std::string town) {
-    boost::algorithm::trim_all(town);
-    boost::algorithm::to_lower(town);
-    std::string enc_town = boost::urls::encode(town, boost::urls::pchars);
-
-    if (!weather_.contains(enc_town)) {
-        auto town_info = geocode_->GetPosition(enc_town);
-        if (town_info) {
-            weather_[enc_town] = {.latitude = town_info->latitude,
-                                  .longitude = town_info->longitude,
-                                  .address = town_info->address};
+std::optional<std::pair<double, double>> ParseCoordinates(std::string_view text) {
+    const auto parse = [](std::string_view part) -> std::optional<double> {
+        while (!part.empty() && std::isspace(static_cast<unsigned char>(part.front()))) {
+            part.remove_prefix(1);
+        }
+        while (!part.empty() && std::isspace(static_cast<unsigned char>(part.back()))) {
+            part.remove_suffix(1);
+        }
+        double value{};
+        const auto [ptr, ec] = std::from_chars(part.data(), part.data() + part.size(), value);
+        if (part.empty() || ec != std::errc{} || ptr != part.data() + part.size()) {
+            return std::nullopt;
+        }
+        return value;
+    };
+
+    const size_t comma = text.find(',');
+    if (comma == std::string_view::npos) {
+        return std::nullopt;
+    }
+    const auto latitude = parse(text.substr(0, comma));
+    const auto longitude = parse(text.substr(comma + 1));
+    if (!latitude || !longitude || std::abs(*latitude) > 90.0 || std::abs(*longitude) > 180.0) {
+        return std::nullopt;
+    }
+    return std::pair{*latitude, *longitude};
+}
+
+std::vector<MeteoInfo> ParseForecast(std::string_view body, size_t expected_locations, size_t expected_points) {
+    std::vector<MeteoInfo> weather;
+    weather.reserve(expected_locations);
+    json::basic_parser<ForecastHandler> parser(json::parse_options{}, weather, expected_points);
+    const auto write = [&parser](bool more, const char* data, size_t size) {
+        boost::system::error_code ec;
+        parser.write_some(more, data, size, ec);
+        if (ec) {
+            throw boost::system::system_error(ec, "open-meteo response");
+        }
+    };
+
+    /* Парсеру передаётся текст до очередной '['. Если с неё начинается массив чисел прогноза, он разбирается
+     * num_scan::DecodeFloatArray сразу во float, а парсеру вместо него передаётся "[]".
+     * Массивы другого вида (и всё остальное) разбирает парсер */
+    std::vector<float> values;  // буфер разбора, обменивается с заполненным массивом прогноза
+    const char* pos = body.data();
+    const char* const end = body.data() + body.size();
+    // '[' начинает значение ключа, только если перед ней (без учёта пробелов) стоит ':', а не открытая строка: "rain":"[
+    const auto after_colon = [begin = body.data()](const char* bracket) {
+        while (bracket != begin && std::isspace(static_cast<unsigned char>(*(bracket - 1)))) {
+            --bracket;
+        }
+        return bracket != begin && *(bracket - 1) == ':';
+    };
+    while (const char* bracket = static_cast<const char*>(std::memchr(pos, '[', static_cast<size_t>(end - pos)))) {
+        write(true, pos, static_cast<size_t>(bracket - pos));
+        std::vector<float>* target = after_colon(bracket) ? parser.handler().NumericTarget() : nullptr;
+        const char* next = target ? num_scan::DecodeFloatArray(bracket, end, values) : nullptr;
+        if (next) {
+            write(true, "[]", 2);
+            std::swap(*target, values);
+            values.clear();
+            pos = next;
         } else {
-            enc_town = DEFAULT_TOWN;
-            if (!weather_.contains(enc_town)) {
-                weather_[enc_town] = {};
-            }
+            write(true, bracket, 1);
+            pos = bracket + 1;
         }
     }
-    if (!weather_[enc_town].valid ||
-        (system_clock::now() - weather_[enc_town].updated_time) > OLD_DATA_TIMEOUT) {
-        try {
-            UpdateWeather(enc_town);
-        } catch (const std::exception& err) {
-            logger::LogError(err.what(), "MeteoBot::GetWeather");
-            return "Ошибка получения прогноза погоды";
+    write(false, pos, static_cast<size_t>(end - pos));
+    return weather;
+}
+
+std::vector<MeteoInfo> ResponseProcessBatch(const boost::json::value& msg) {
+    std::vector<MeteoInfo> weather;
+    if (msg.is_object()) {
+        weather.push_back(ResponseProcess(msg.as_object()));
+    } else if (msg.is_array()) {
+        weather.reserve(msg.as_array().size());
+        for (const auto& val : msg.as_array()) {
+            weather.push_back(val.is_object() ? ResponseProcess(val.as_object()) : MeteoInfo{});
+        }
+    }
+    return weather;
+}
+}
+
+/* -------- ForecastBatcher -------- */
+
+ForecastBatcher::ForecastBatcher(boost::asio::any_io_executor executor,
+                                 std::shared_ptr<https_pool::HttpsPool> pool,
+                                 BatchSettings settings)
+    : executor_(std::move(executor))
+    , pool_(std::move(pool))
+    , settings_(settings) {}
+
+/* Запрос добавляется в собираемый пакет. Пакет отправляется, когда наберётся max_locations точек
+ * или истечёт окно window с момента поступления первого запроса пакета */
+boost::asio::awaitable<MeteoInfo> ForecastBatcher::Fetch(double latitude, double longitude) {
+    auto request = std::make_shared<Request>(executor_, latitude, longitude);
+    pending_.push_back(request);
+    if (pending_.size() >= settings_.max_locations) {
+        ++batch_id_;
+        boost::asio::co_spawn(executor_, Flush(std::exchange(pending_, {})), boost::asio::detached);
+    } else if (pending_.size() == 1) {
+        boost::asio::co_spawn(executor_, FlushAfterWindow(batch_id_), boost::asio::detached);
+    }
+
+    co_await request->done.Wait();
+    if (request->error) {
+        std::rethrow_exception(request->error);
+    }
+    co_return std::move(*request->result);
+}
+
+uint64_t ForecastBatcher::Batches() const noexcept {
+    return batches_;
+}
+
+boost::asio::awaitable<void> ForecastBatcher::FlushAfterWindow(uint64_t batch_id) {
+    boost::asio::steady_timer timer(executor_, settings_.window);
+    co_await timer.async_wait(boost::asio::use_awaitable);
+    // пакет мог уже уйти по достижении max_locations
+    if (batch_id == batch_id_ && !pending_.empty()) {
+        ++batch_id_;
+        co_await Flush(std::exchange(pending_, {}));
+    }
+}
+
+// Отправка пакета и раздача результатов ожидающим
+boost::asio::awaitable<void> ForecastBatcher::Flush(Batch batch) {
+    ++batches_;
+    try {
+        auto weather = co_await FetchBatch(batch);
+        if (weather.size() != batch.size()) {
+            throw std::runtime_error(std::format("Forecast count mismatch: requested {}, received {}",
+                                                 batch.size(), weather.size()));
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            batch[i]->result = std::move(weather[i]);
+        }
+    } catch (const std::exception& err) {
+        LOG_LIMITED(logger::Level::error, 10, err.what(), "ForecastBatcher::Flush");
+        for (auto& request : batch) {
+            request->error = std::current_exception();
         }
     }
-    return weather_[enc_town].ToString();
+    for (auto& request : batch) {
+        request->done.Set();
+    }
 }
 
-void MeteoBot::UpdateWeather(const std::string& town) {
+boost::asio::awaitable<std::vector<MeteoInfo>> ForecastBatcher::FetchBatch(const Batch& batch) {
     const int http_version{11};
 
-    client_->Connect(HOST);
+    std::string latitudes;
+    std::string longitudes;
+    for (const auto& request : batch) {
+        if (!latitudes.empty()) {
+            latitudes += ',';
+            longitudes += ',';
+        }
+        latitudes += std::format("{}", request->latitude);
+        longitudes += std::format("{}", request->longitude);
+    }
     std::string target = std::format("/v1/forecast?latitude={}&longitude={}"
                                      "&hourly=temperature_2m,rain,snowfall"
                                      "&timezone=Europe%2FMoscow"
-                                     "&forecast_days=2"
+                                     "&timeformat=unixtime"
+                                     "&forecast_days={}"
                                      "&temporal_resolution=hourly_{}",
-                                     weather_[town].latitude, weather_[town].longitude, HOUR_RESOLUTION);
+                                     latitudes, longitudes, FORECAST_DAYS, MeteoBot::HOUR_RESOLUTION);
 
     http::request<http::string_body> req{http::verb::get,
                                          target,
                                          http_version};
     req.set(http::field::host, HOST);
 
-    std::string answer = client_->Exchange(std::move(req));
-    if (!answer.empty()) {
-        auto weather = util::ResponseProcess(json::parse(answer).as_object());
-        weather_[town].updated_time = weather.updated_time;
-        weather_[town].valid = weather.valid;
-        weather_[town].forecast = std::move(weather.forecast);
-        weather_[town].units = std::move(weather.units);
+    std::string answer = co_await pool_->Exchange(HOST, std::move(req));
+    if (answer.empty()) {
+        co_return std::vector<MeteoInfo>(batch.size());
+    }
+    co_return util::ParseForecast(answer, batch.size(), FORECAST_DAYS * 24 / MeteoBot::HOUR_RESOLUTION);
+}
+
+/* -------- MeteoBot -------- */
+
+size_t GridCellHash::operator()(const GridCell& cell) const noexcept {
+    return std::hash<uint64_t>{}((static_cast<uint64_t>(static_cast<uint32_t>(cell.lat_idx)) << 32) |
+                                 static_cast<uint32_t>(cell.lon_idx));
+}
+
+MeteoBot::MeteoBot(boost::asio::any_io_executor executor,
+                   std::shared_ptr<https_pool::HttpsPool> pool,
+                   MeteoSettings settings)
+    : executor_(std::move(executor))
+    , pool_(std::move(pool))
+    , geocode_(std::make_unique<geo::Geocode>(pool_, util::LoadGazetteer(settings.gazetteer_file)))
+    , batcher_(std::make_unique<ForecastBatcher>(executor_, pool_, settings.batch))
+    , settings_(std::move(settings))
+    , weather_(settings_.forecast_cache, [](const GridCell&, const MeteoInfo& info) {
+        return info.ApproxBytes();
+    })
+    , towns_(settings_.town_cache, [](const std::string& town, const TownInfo& info) {
+        return town.capacity() + info.address.capacity();
+    })
+    , geocode_flights_(executor_)
+    , forecast_flights_(executor_) {
+    // номер ячейки (lround(координата / шаг)) должен быть конечным и помещаться в int32_t
+    if (!(settings_.grid_resolution > 0) ||
+        180.0 / settings_.grid_resolution > static_cast<double>(std::numeric_limits<int32_t>::max())) {
+        throw std::invalid_argument(std::format("Invalid grid_resolution: {}", settings_.grid_resolution));
+    }
+}
+
+/* Получаем погоду для запрошенного города
+ * 1) координаты (например, присланная в telegram геопозиция) привязываются к сетке без поиска по названию
+ * 2) название приводим к нормализованному ключу (normalize::Normalizer): разные написания одного города дают один ключ
+ * 3) по индексу названий находим ячейку сетки, если название новое - определяем её в ResolveTown
+ * 4) получаем погоду для ячейки сетки:
+ *      - если погода ещё не получена или если данные устарели, обновляем погодные данные
+ *      - если данные устарели недавно (не более stale_grace), отвечаем ими сразу, а обновляем в фоне
+ * Пока корутина ожидает ответа сервера, кэши могут измениться другими запросами (в том числе
+ * запись может быть вытеснена), поэтому указатели на элементы кэшей после co_await ищутся заново */
+boost::asio::awaitable<telega::ReplyPtr> MeteoBot::GetWeather(std::string town, tracing::TracePtr trace) {
+    static const telega::ReplyPtr error_reply = telega::MakeReply("Ошибка получения прогноза погоды");
+
+    TownInfo town_info;
+    if (auto coords = util::ParseCoordinates(town)) {
+        const auto [latitude, longitude] = *coords;
+        town_info = {.cell = ToCell(latitude, longitude),
+                     .address = std::format("{:.4f}, {:.4f}", latitude, longitude)};
+    } else {
+        std::string key = normalizer_.Key(town);
+        if (key.empty()) {
+            town_info = {.cell = ToCell(KAZAN_LATITUDE, KAZAN_LONGITUDE), .address = KAZAN_ADDRESS};
+        } else if (const TownInfo* cached = towns_.Get(key)) {
+            town_info = *cached;
+        } else {
+            town_info = co_await ResolveTown(std::move(key), normalize::Normalizer::Query(town), trace);
+        }
+    }
+    const GridCell cell = town_info.cell;
+
+    MeteoInfo* info = weather_.Get(cell);
+    if (!info) {
+        const auto [latitude, longitude] = CellCenter(cell);
+        info = &weather_.Put(cell, {.latitude = latitude, .longitude = longitude});
+    }
+    MeteoInfo fetched;
+    const bool valid = info->valid;
+    const auto age = system_clock::now() - info->updated_time;
+    ++info->hits;
+    if (valid && age > OLD_DATA_TIMEOUT && age <= OLD_DATA_TIMEOUT + settings_.refresh.stale_grace) {
+        ++stale_served_;
+        Metrics().stale.Inc();
+        boost::asio::co_spawn(executor_, RefreshWeather(cell), boost::asio::detached);
+    } else if (!valid || age > OLD_DATA_TIMEOUT) {
+        Metrics().miss.Inc();
+        try {
+            fetched = co_await UpdateWeather(cell, trace);
+        } catch (const std::exception& err) {
+            Metrics().errors.Inc();
+            LOG_LIMITED(logger::Level::error, 10, err.what(), "MeteoBot::GetWeather");
+            co_return error_reply;
+        }
+        // за время обновления запись могла быть вытеснена из кэша, тогда отвечаем полученным прогнозом
+        info = weather_.Peek(cell);
+        if (!info) {
+            if (!fetched.valid) {
+                Metrics().errors.Inc();
+                co_return error_reply;
+            }
+            info = &fetched;
+        }
+    } else {
+        Metrics().fresh.Inc();
+    }
+    tracing::Span span(trace, "format");
+    auto reply = info->CachedReply(town_info.address);
+    if (info != &fetched) {
+        weather_.Resize(cell); // ответ мог добавиться в replies, срок жизни прогноза при этом не продлевается
+    }
+    co_return reply;
+}
+
+/* Определение ячейки сетки для нового названия
+ * - запрашиваем координаты города в Geocode (если запрос с таким же ключом уже выполняется, дожидаемся его результата)
+ *   key - нормализованный ключ (для справочника и кэшей), query - исходное название для запроса к geocode
+ * - если города не существует (не найден в geocode) используем город по умолчанию, в индекс его не запоминаем:
+ *   ненайденные названия запоминает сам Geocode */
+boost::asio::awaitable<TownInfo> MeteoBot::ResolveTown(std::string key, std::string query, tracing::TracePtr trace) {
+    // интервал geocode записывается только в трассу запроса, выполнившего его; остальные видят здесь ожидание
+    tracing::Span span(trace, "resolveTown");
+    auto geo_info = co_await geocode_flights_.Run(key, [this, key, query = std::move(query), trace] {
+        return geocode_->GetPosition(key, query, trace);
+    });
+    if (!geo_info) {
+        co_return TownInfo{.cell = ToCell(KAZAN_LATITUDE, KAZAN_LONGITUDE), .address = KAZAN_ADDRESS};
+    }
+    co_return towns_.Put(key, {.cell = ToCell(geo_info->latitude, geo_info->longitude),
+                               .address = std::move(geo_info->address)});
+}
+
+GridCell MeteoBot::ToCell(double latitude, double longitude) const noexcept {
+    return {.lat_idx = static_cast<int32_t>(std::lround(latitude / settings_.grid_resolution)),
+            .lon_idx = static_cast<int32_t>(std::lround(longitude / settings_.grid_resolution))};
+}
+
+std::pair<double, double> MeteoBot::CellCenter(GridCell cell) const noexcept {
+    return {cell.lat_idx * settings_.grid_resolution, cell.lon_idx * settings_.grid_resolution};
+}
+
+cache::CacheStats MeteoBot::GetCacheStats() const noexcept {
+    return weather_.GetStats();
+}
+
+cache::CacheStats MeteoBot::GetTownStats() const noexcept {
+    return towns_.GetStats();
+}
+
+cache::CacheStats MeteoBot::GetNotFoundStats() const noexcept {
+    return geocode_->GetNotFoundStats();
+}
+
+RequestStats MeteoBot::GetRequestStats() const noexcept {
+    return {.geocode_requests = geocode_flights_.Executed(),
+            .gazetteer_hits = geocode_->LocalHits(),
+            .geocode_coalesced = geocode_flights_.Coalesced(),
+            .forecast_requests = forecast_flights_.Executed(),
+            .forecast_coalesced = forecast_flights_.Coalesced(),
+            .forecast_batches = batcher_->Batches(),
+            .stale_served = stale_served_,
+            .refreshed_ahead = refreshed_ahead_};
+}
+
+/* Фоновое обновление: раз в period выбираем до top_towns самых запрашиваемых ячеек сетки,
+ * данные которых устареют в ближайшие lead минут, и обновляем их, равномерно распределяя
+ * запросы по периоду. Счётчики обращений уменьшаются вдвое, чтобы популярность отражала недавний спрос */
+boost::asio::awaitable<void> MeteoBot::RunRefresh() {
+    boost::asio::steady_timer timer(executor_);
+    while (true) {
+        auto cells = SelectRefreshCandidates();
+        const auto step = std::chrono::duration_cast<milliseconds>(settings_.refresh.period) / (cells.size() + 1);
+        for (const auto cell : cells) {
+            timer.expires_after(step);
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            ++refreshed_ahead_;
+            co_await RefreshWeather(cell);
+        }
+        timer.expires_after(step);
+        co_await timer.async_wait(boost::asio::use_awaitable);
+    }
+}
+
+std::vector<GridCell> MeteoBot::SelectRefreshCandidates() {
+    const auto now = system_clock::now();
+    std::vector<std::pair<uint64_t, GridCell>> candidates;
+    weather_.EvictExpired();
+    towns_.EvictExpired();
+    weather_.ForEach([&](const GridCell& cell, MeteoInfo& info) {
+        if (info.valid && info.hits > 0 &&
+            now - info.updated_time > OLD_DATA_TIMEOUT - settings_.refresh.lead) {
+            candidates.emplace_back(info.hits, cell);
+        }
+        info.hits /= 2;
+    });
+    const size_t count = std::min(candidates.size(), settings_.refresh.top_towns);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                      [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
+
+    std::vector<GridCell> cells;
+    cells.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        cells.push_back(candidates[i].second);
+    }
+    return cells;
+}
+
+boost::asio::awaitable<void> MeteoBot::RefreshWeather(GridCell cell) {
+    try {
+        co_await UpdateWeather(cell);
+    } catch (const std::exception& err) {
+        LOG_LIMITED(logger::Level::error, 10, err.what(), "MeteoBot::RefreshWeather");
+    }
+}
+
+/* Обновление погоды для ячейки сетки. Запросы погоды в одной ячейке объединяются:
+ * если прогноз для неё уже запрашивается, ждём его результата.
+ * Запросы для разных ячеек собираются в пакеты в ForecastBatcher */
+boost::asio::awaitable<MeteoInfo> MeteoBot::UpdateWeather(GridCell cell, tracing::TracePtr trace) {
+    const auto [latitude, longitude] = CellCenter(cell);
+
+    metrics::ScopedTimer timer(Metrics().update_latency);
+    tracing::Span span(trace, "updateWeather");
+    if (trace) {
+        span.Arg("cell", std::format("{},{}", cell.lat_idx, cell.lon_idx));
+    }
+    auto weather = co_await forecast_flights_.Run(cell, [this, latitude, longitude] {
+        return batcher_->Fetch(latitude, longitude);
+    });
+    MeteoInfo* info = weather_.Peek(cell);
+    if (weather.valid && info) {
+        info->Refresh(weather);
+        weather_.Update(cell);
+    }
+    co_return weather;
+}
+
+/* -------- Снимок кэшей -------- */
+
+/* Формат снимка (fileutil BinaryWriter):
+ * - magic, версия, шаг сетки (снимок с другим шагом сетки не загружается), время создания
+ * - индекс названий: количество, {ключ, ячейка, описание}
+ * - прогнозы, которыми ещё можно отвечать: количество, {ячейка, прогноз}
+ * Записи идут от недавно использованных к давно не использованным */
+std::string MeteoBot::SerializeSnapshot() {
+    const auto now = system_clock::now();
+    file_util::BinaryWriter writer;
+    writer.Put<uint32_t>(SNAPSHOT_MAGIC);
+    writer.Put<uint32_t>(SNAPSHOT_VERSION);
+    writer.Put<double>(settings_.grid_resolution);
+    writer.Put<int64_t>(duration_cast<milliseconds>(now.time_since_epoch()).count());
+
+    writer.Put<uint32_t>(static_cast<uint32_t>(towns_.Size()));
+    towns_.ForEach([&writer](const std::string& key, const TownInfo& info) {
+        writer.PutString(key);
+        writer.Put<int32_t>(info.cell.lat_idx);
+        writer.Put<int32_t>(info.cell.lon_idx);
+        writer.PutString(info.address);
+    });
+
+    std::vector<std::pair<GridCell, const MeteoInfo*>> forecasts;
+    weather_.ForEach([&](const GridCell& cell, const MeteoInfo& info) {
+        if (info.valid && now - info.updated_time <= OLD_DATA_TIMEOUT + settings_.refresh.stale_grace) {
+            forecasts.emplace_back(cell, &info);
+        }
+    });
+    writer.Put<uint32_t>(static_cast<uint32_t>(forecasts.size()));
+    for (const auto& [cell, info] : forecasts) {
+        writer.Put<int32_t>(cell.lat_idx);
+        writer.Put<int32_t>(cell.lon_idx);
+        util::SerializeForecast(writer, *info);
+    }
+    return std::string(writer.Data());
+}
+
+/* Файл отображается в память и разбирается целиком до изменения кэшей:
+ * повреждённый снимок не загружается совсем. Записи добавляются от давно использованных
+ * к недавно использованным, чтобы сохранить порядок вытеснения */
+void MeteoBot::LoadSnapshot() {
+    if (settings_.snapshot_file.empty() || !std::filesystem::exists(settings_.snapshot_file)) {
+        return;
+    }
+    try {
+        bip::file_mapping file(settings_.snapshot_file.c_str(), bip::read_only);
+        bip::mapped_region region(file, bip::read_only);
+        file_util::BinaryReader reader({static_cast<const char*>(region.get_address()), region.get_size()});
+
+        if (reader.Get<uint32_t>() != SNAPSHOT_MAGIC || reader.Get<uint32_t>() != SNAPSHOT_VERSION) {
+            throw std::runtime_error("Unknown snapshot format");
+        }
+        if (reader.Get<double>() != settings_.grid_resolution) {
+            logger::LogInfo("Grid resolution changed, snapshot skipped", "MeteoBot::LoadSnapshot");
+            return;
+        }
+        reader.Get<int64_t>(); // время создания
+
+        std::vector<std::pair<std::string, TownInfo>> towns;
+        const uint32_t town_count = reader.Get<uint32_t>();
+        for (uint32_t i = 0; i < town_count; ++i) {
+            std::string key{reader.GetString()};
+            TownInfo info;
+            info.cell.lat_idx = reader.Get<int32_t>();
+            info.cell.lon_idx = reader.Get<int32_t>();
+            info.address = reader.GetString();
+            towns.emplace_back(std::move(key), std::move(info));
+        }
+
+        const auto now = system_clock::now();
+        std::vector<std::pair<GridCell, MeteoInfo>> forecasts;
+        const uint32_t forecast_count = reader.Get<uint32_t>();
+        for (uint32_t i = 0; i < forecast_count; ++i) {
+            GridCell cell;
+            cell.lat_idx = reader.Get<int32_t>();
+            cell.lon_idx = reader.Get<int32_t>();
+            MeteoInfo info = util::DeserializeForecast(reader);
+            std::tie(info.latitude, info.longitude) = CellCenter(cell);
+            // пока бот не работал, часть прогнозов могла устареть окончательно
+            if (info.valid && now - info.updated_time <= OLD_DATA_TIMEOUT + settings_.refresh.stale_grace) {
+                forecasts.emplace_back(cell, std::move(info));
+            }
+        }
+        if (!reader.AtEnd()) {
+            throw std::runtime_error("Unexpected data at the end of snapshot");
+        }
+
+        for (auto it = towns.rbegin(); it != towns.rend(); ++it) {
+            towns_.Put(it->first, std::move(it->second));
+        }
+        for (auto it = forecasts.rbegin(); it != forecasts.rend(); ++it) {
+            weather_.Put(it->first, std::move(it->second));
+        }
+        logger::LogInfo(std::format("Snapshot loaded: {} towns, {} forecasts", towns.size(), forecasts.size()),
+                        "MeteoBot::LoadSnapshot");
+    } catch (const std::exception& err) {
+        logger::LogError(err.what(), "MeteoBot::LoadSnapshot");
+    }
+}
+
+void MeteoBot::SaveSnapshot() {
+    if (settings_.snapshot_file.empty()) {
+        return;
+    }
+    WriteSnapshot(SerializeSnapshot(), ++snapshot_generation_);
+}
+
+/* Снимок формируется в io_context (кэши используются только в нём), а записывается на диск
+ * в отдельном потоке, чтобы запись и fsync не задерживали обработку запросов */
+boost::asio::awaitable<void> MeteoBot::RunSnapshots() {
+    if (settings_.snapshot_file.empty()) {
+        co_return;
+    }
+    boost::asio::steady_timer timer(executor_);
+    while (true) {
+        timer.expires_after(settings_.snapshot_period);
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        boost::asio::post(snapshot_writer_, [this, data = SerializeSnapshot(), generation = ++snapshot_generation_]() mutable {
+            WriteSnapshot(std::move(data), generation);
+        });
+    }
+}
+
+// Более старый снимок не перезаписывает более новый (например, итоговый снимок при завершении работы)
+void MeteoBot::WriteSnapshot(std::string data, uint64_t generation) {
+    std::lock_guard lock(snapshot_mutex_);
+    if (generation <= snapshot_written_) {
+        return;
+    }
+    try {
+        file_util::WriteFileAtomic(settings_.snapshot_file, data);
+        snapshot_written_ = generation;
+    } catch (const std::exception& err) {
+        logger::LogError(err.what(), "MeteoBot::WriteSnapshot");
     }
-    client_->Disconnect();
 }
 
 /* -------- MeteoInfo -------- */
 
-std::string MeteoInfo::ToString() const {
-    const time_t cur_time_t{system_clock::to_time_t(system_clock::now())};
-    tm cur_tm{};
-#ifdef Q_OS_WINDOWS
-    localtime_s(&cur_tm, &cur_time_t);
-#endif
-#ifdef Q_OS_LINUX
-    localtime_r(&cur_time_t, &cur_tm);
-#endif
-    if (!forecast.time.empty()) {
-        const size_t idx = cur_tm.tm_hour / MeteoBot::HOUR_RESOLUTION + 1;
-
-        std::string time = (forecast.time.size() > idx) ? forecast.time[idx] : "NONE";
-        float temperature = (forecast.temperature.size() > idx) ? forecast.temperature[idx] : INFINITY;
-        float rain = (forecast.rain.size() > idx) ? forecast.rain[idx] : 0;
-        float snowfall = (forecast.snowfall.size() > idx) ? forecast.snowfall[idx] : 0;
-
-        return std::format("Погода в {} на {}:\nТемпература: {} °C\nОсадки: {} мм",
-                           address, time, temperature, rain + snowfall * 10);
+// Оценка памяти, занимаемой данными вне самой структуры (единицы измерения общие и не учитываются)
+size_t MeteoInfo::ApproxBytes() const noexcept {
+    size_t bytes = forecast.ApproxBytes() + replies.capacity() * sizeof(decltype(replies)::value_type);
+    for (const auto& [address, reply] : replies) {
+        bytes += address.capacity() + reply->ApproxBytes();
+    }
+    return bytes;
+}
+
+// Координаты и счётчик обращений остаются прежними
+void MeteoInfo::Refresh(const MeteoInfo& fetched) {
+    updated_time = fetched.updated_time;
+    valid = fetched.valid;
+    forecast = fetched.forecast;
+    units = fetched.units;
+    replies.clear();
+}
+
+std::string MeteoInfo::ToString(std::string_view address, TimePoint now) const {
+    const auto slot = forecast.Slot(duration_cast<seconds>(now.time_since_epoch()).count());
+    if (slot && *slot + 1 < forecast.Size()) {
+        const size_t idx = *slot + 1;
+        const sys_seconds local_time{seconds{forecast.Time(idx) + forecast.UtcOffset()}};
+        const float temperature = forecast.Values(Forecast::Variable::temperature)[idx];
+        // нет данных об осадках - считаем, что осадков нет
+        const auto precipitation = [&](Forecast::Variable variable) {
+            const float value = forecast.Values(variable)[idx];
+            return std::isnan(value) ? 0.0f : value;
+        };
+        const float rain = precipitation(Forecast::Variable::rain);
+        const float snowfall = precipitation(Forecast::Variable::snowfall);
+
+        return std::format("Погода в {} на {:%Y-%m-%dT%H:%M}:\nТемпература: {} °C\nОсадки: {} мм",
+                           address, local_time, temperature, rain + snowfall * 10);
     } else {
-        return std::format("Ошибка при разборе ответа от сервера."
-                           "Размер массива time: {}"
-                           "Размер массива temperature: {}"
-                           "Размер массива rain: {}"
-                           "Размер массива snowfall: {}",
-                           forecast.time.size(), forecast.temperature.size(),
-                           forecast.rain.size(), forecast.snowfall.size());
+        return std::format("Ошибка при разборе ответа от сервера. "
+                           "Размер прогноза: {}, начало: {}, шаг: {}",
+                           forecast.Size(), forecast.Start(), forecast.Step());
+    }
+}
+
+/* Ответы запоминаются только для текущего срока прогноза: при переходе к следующему сроку список очищается.
+ * Разные названия в одной ячейке дают разные ответы, поэтому ответ ищется по описанию места */
+telega::ReplyPtr MeteoInfo::CachedReply(std::string_view address, TimePoint now) {
+    const auto slot = forecast.Slot(duration_cast<seconds>(now.time_since_epoch()).count());
+    if (!slot || *slot + 1 >= forecast.Size()) {
+        Metrics().reply_miss.Inc();
+        return telega::MakeReply(ToString(address, now)); // ответ об ошибке не запоминается
+    }
+    if (*slot != replies_slot) {
+        replies.clear();
+        replies_slot = *slot;
+    }
+    auto it = std::find_if(replies.begin(), replies.end(), [address](const auto& reply) {
+        return reply.first == address;
+    });
+    if (it != replies.end()) {
+        Metrics().reply_hit.Inc();
+        return it->second;
+    }
+    Metrics().reply_miss.Inc();
+    if (replies.size() >= MAX_REPLIES) {
+        replies.erase(replies.begin());
+    }
+    return replies.emplace_back(std::string(address), telega::MakeReply(ToString(address, now))).second;
+}
+
+/* -------- Forecast -------- */
+
+void Forecast::AlignedDelete::operator()(float* ptr) const noexcept {
+    ::operator delete[](ptr, std::align_val_t{ALIGNMENT});
+}
+
+Forecast::Forecast(int64_t start, int32_t step, int32_t utc_offset, size_t size)
+    : start_(start)
+    , step_(step)
+    , utc_offset_(utc_offset)
+    , size_(size) {
+    if (size_ != 0) {
+        values_.reset(static_cast<float*>(::operator new[](VARIABLES * size_ * sizeof(float), std::align_val_t{ALIGNMENT})));
+        std::fill_n(values_.get(), VARIABLES * size_, std::numeric_limits<float>::quiet_NaN());
+    }
+}
+
+Forecast::Forecast(const Forecast& other)
+    : Forecast(other.start_, other.step_, other.utc_offset_, other.size_) {
+    std::copy_n(other.values_.get(), VARIABLES * size_, values_.get());
+}
+
+Forecast::Forecast(Forecast&& other) noexcept
+    : start_(other.start_)
+    , step_(other.step_)
+    , utc_offset_(other.utc_offset_)
+    , size_(std::exchange(other.size_, 0))
+    , values_(std::move(other.values_)) {}
+
+Forecast& Forecast::operator=(const Forecast& other) {
+    if (this != &other) {
+        *this = Forecast(other);
+    }
+    return *this;
+}
+
+Forecast& Forecast::operator=(Forecast&& other) noexcept {
+    start_ = other.start_;
+    step_ = other.step_;
+    utc_offset_ = other.utc_offset_;
+    size_ = std::exchange(other.size_, 0);
+    values_ = std::move(other.values_);
+    return *this;
+}
+
+size_t Forecast::Size() const noexcept {
+    return size_;
+}
+
+int64_t Forecast::Start() const noexcept {
+    return start_;
+}
+
+int32_t Forecast::Step() const noexcept {
+    return step_;
+}
+
+int32_t Forecast::UtcOffset() const noexcept {
+    return utc_offset_;
+}
+
+int64_t Forecast::Time(size_t index) const noexcept {
+    return start_ + static_cast<int64_t>(index) * step_;
+}
+
+std::optional<size_t> Forecast::Slot(int64_t time) const noexcept {
+    if (size_ == 0 || time < start_) {
+        return std::nullopt;
     }
+    if (step_ <= 0) {
+        return size_ == 1 ? std::optional<size_t>{0} : std::nullopt;
+    }
+    const auto index = static_cast<size_t>((time - start_) / step_);
+    return index < size_ ? std::optional<size_t>{index} : std::nullopt;
+}
+
+std::span<float> Forecast::Values(Variable variable) noexcept {
+    return {values_.get() + static_cast<size_t>(variable) * size_, size_};
+}
+
+std::span<const float> Forecast::Values(Variable variable) const noexcept {
+    return {values_.get() + static_cast<size_t>(variable) * size_, size_};
+}
+
+std::span<float> Forecast::Block() noexcept {
+    return {values_.get(), VARIABLES * size_};
+}
+
+std::span<const float> Forecast::Block() const noexcept {
+    return {values_.get(), VARIABLES * size_};
+}
+
+size_t Forecast::ApproxBytes() const noexcept {
+    const size_t bytes = VARIABLES * size_ * sizeof(float);
+    return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
 }
 
 }
@@ -1,30 +1,61 @@
 #pragma once
 /*
  * Получение и хранение информации о погоде в городах
- * 1) Запрашиваем координаты города у класса geo::Geocode
- * 2) По полученным координатам запрашиваем погоду у open-meteo.com и возвращаем в виде строки
+ * 1) Запрашиваем координаты города у класса geo::Geocode (сначала в локальном справочнике, если он задан)
+ * 2) По полученным координатам запрашиваем погоду у open-meteo.com и возвращаем в виде ответа telegram
  * Примечания:
- * 1) Координаты запрашиваются только для новых городов (для несуществующих городов запрашиваются всегда!)
+ * 1) Координаты запрашиваются только для новых городов (и городов, вытесненных из кэша),
+ *    несуществующие города запоминаются в geo::Geocode и повторно не запрашиваются в течение ttl
  * 2) Погода запрашивается только для ранее не запрошенных городов и по прошествии таймаута устаревания данных
+ * 3) Одновременные запросы координат одного города (и погоды в одной точке) объединяются в один запрос к серверу
+ * 4) Запросы погоды в разных точках, пришедшие в течение короткого окна, отправляются в open-meteo одним запросом
+ * 5) Погода в самых популярных городах обновляется в фоне незадолго до устаревания (RunRefresh),
+ *    недавно устаревшие данные отдаются сразу, а обновление выполняется в фоне
+ * 6) Прогнозы хранятся по ячейкам сетки координат: разные названия одного места (и присланные геопозиции)
+ *    используют один прогноз. Названия привязываются к ячейкам через отдельный индекс
  *
  * Использование:
- *** meteo::MeteoBot bot(ioc);
- *** std::string weather = bot.GetWeather(std::move(town));
+ *** auto pool = std::make_shared<https_pool::HttpsPool>(ioc.get_executor());
+ *** meteo::MeteoBot bot(ioc.get_executor(), pool, meteo_settings);
+ *** bot.LoadSnapshot();
+ *** boost::asio::co_spawn(ioc, bot.RunRefresh(), boost::asio::detached); // фоновое обновление популярных городов
+ *** boost::asio::co_spawn(ioc, bot.RunSnapshots(), boost::asio::detached);
+ *** telega::ReplyPtr weather = co_await bot.GetWeather(std::move(town));
+ * Запросы к geocode и open-meteo выполняются асинхронно на подключениях из общего пула
+ * 7) Названия нормализуются (normalize::Normalizer): написания транслитом и кириллицей, с регионом (страной)
+ *    и без них приводятся к одному ключу и используют одну запись индекса названий
+ * 8) Индекс названий и действительные прогнозы периодически сохраняются в файл снимка и загружаются при запуске,
+ *    после перезапуска не требуется заново запрашивать geocode и open-meteo
+ * 9) Ответ для места запоминается до смены срока прогноза или обновления прогноза: повторные запросы
+ *    того же места не форматируют текст и не строят JSON (тело sendMessage собирается подстановкой chat_id)
  *
  * TODO:
- * 1) Исключить дублирование информации о городах введённых в транслите и кириллицей, а также с указанием региона (и/или страны) и без неё
- * 2) Оптимизировать запросы на обновление данных о погоде и получение информации о координатах города
+ * 1) Оптимизировать запросы на обновление данных о погоде и получение информации о координатах города
  */
+#include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <boost/json.hpp>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
-#include <unordered_map>
 
-#include "httpssyncclient.h"
+#include "asyncutil.h"
+#include "fileutil.h"
+#include "httpspool.h"
 #include "geocode.h"
+#include "lrucache.h"
+#include "normalize.h"
+#include "reply.h"
+#include "tracing.h"
 
 namespace meteo {
 
@@ -32,59 +63,270 @@ constexpr static double KAZAN_LATITUDE{55.8125}; // широта
 constexpr static double KAZAN_LONGITUDE{49.1221}; // долгота
 constexpr static char KAZAN_ADDRESS[]{"Россия, Республика Татарстан (Татарстан), Казань"};
 
+/* Единицы измерения прогноза. Одинаковы для всех точек, поэтому хранятся в общей таблице:
+ * MeteoInfo ссылается на экземпляр, полученный от InternUnits */
 struct Units {
-    std::string time_format{"iso8601"};
+    std::string time_format{"unixtime"};
     std::string temperature{"°C"};
     std::string rain{"mm"};
     std::string snowfall{"cm"};
+
+    bool operator==(const Units&) const = default;
 };
 
-struct Forecast {
-    std::vector<std::string> time;
-    std::vector<float> temperature;
-    std::vector<float> rain;
-    std::vector<float> snowfall;
+// Экземпляр общей таблицы с такими же значениями, существует до завершения программы
+const Units* InternUnits(const Units& units);
+const Units* DefaultUnits() noexcept;
+
+/* Почасовой прогноз в компактном виде: время значений задаётся началом (unix time) и шагом,
+ * значения всех величин лежат подряд в одном выровненном блоке (Size() значений каждой величины)
+ * Блок записывается в снимок кэша как есть */
+class Forecast {
+public:
+    enum class Variable : size_t { temperature, rain, snowfall };
+    constexpr static size_t VARIABLES{3};
+    constexpr static size_t ALIGNMENT{64};
+
+    Forecast() = default;
+    Forecast(int64_t start, int32_t step, int32_t utc_offset, size_t size); // значения - NaN
+    Forecast(const Forecast& other);
+    Forecast(Forecast&& other) noexcept;
+    Forecast& operator=(const Forecast& other);
+    Forecast& operator=(Forecast&& other) noexcept;   // other остаётся пустым
+
+    size_t Size() const noexcept;
+    int64_t Start() const noexcept;         // unix time первого значения, секунды
+    int32_t Step() const noexcept;          // секунды
+    int32_t UtcOffset() const noexcept;     // смещение часового пояса прогноза от UTC, секунды
+    int64_t Time(size_t index) const noexcept;
+
+    // Номер значения, действующего в момент time (Time(i) <= time < Time(i) + Step()), nullopt - вне прогноза
+    std::optional<size_t> Slot(int64_t time) const noexcept;
+
+    std::span<float> Values(Variable variable) noexcept;
+    std::span<const float> Values(Variable variable) const noexcept;
+    std::span<float> Block() noexcept;      // все значения: VARIABLES * Size()
+    std::span<const float> Block() const noexcept;
+
+    size_t ApproxBytes() const noexcept;
+
+private:
+    struct AlignedDelete {
+        void operator()(float* ptr) const noexcept;
+    };
+
+    int64_t start_{};
+    int32_t step_{};
+    int32_t utc_offset_{};
+    size_t size_{};
+    std::unique_ptr<float[], AlignedDelete> values_;
 };
 
 using TimePoint = std::chrono::time_point<std::chrono::system_clock>;
 
 struct MeteoInfo {
+    constexpr static size_t MAX_REPLIES{8};    // готовых ответов на ячейку (разные названия мест в ней)
+
     double latitude{KAZAN_LATITUDE};
     double longitude{KAZAN_LONGITUDE};
     TimePoint updated_time{std::chrono::system_clock::now()};
     bool valid{false};
-    Units units{};
+    const Units* units{DefaultUnits()};
     Forecast forecast{};
+    uint64_t hits{};    // количество обращений, уменьшается вдвое в каждом цикле фонового обновления
+
+    /* Готовые ответы (описание места, ответ) для срока прогноза replies_slot
+     * Сбрасываются при обновлении прогноза и при смене срока, учитываются в размере записи кэша (ApproxBytes) */
+    std::vector<std::pair<std::string, telega::ReplyPtr>> replies{};
+    size_t replies_slot{};
+
+    // Замена прогноза полученным от open-meteo, готовые ответы сбрасываются
+    void Refresh(const MeteoInfo& fetched);
+    // Прогноз на ближайший следующий срок после now
+    std::string ToString(std::string_view address, TimePoint now = std::chrono::system_clock::now()) const;
+    /* То же в виде ответа telegram: готовый ответ из replies или сформированный и запомненный в replies
+     * replies могут измениться, после вызова размер записи кэша нужно пересчитать (LruCache::Resize) */
+    telega::ReplyPtr CachedReply(std::string_view address, TimePoint now = std::chrono::system_clock::now());
+    size_t ApproxBytes() const noexcept;
+};
+
+// Ячейка сетки координат: близкие точки попадают в одну ячейку и используют один прогноз
+struct GridCell {
+    int32_t lat_idx{};
+    int32_t lon_idx{};
+
+    bool operator==(const GridCell&) const = default;
+};
+
+struct GridCellHash {
+    size_t operator()(const GridCell& cell) const noexcept;
+};
+
+// Город: ячейка сетки и описание, полученное от geocode
+struct TownInfo {
+    GridCell cell{};
     std::string address{KAZAN_ADDRESS};
+};
+
+using MeteoMap = cache::LruCache<GridCell, MeteoInfo, GridCellHash>;  // Ячейки сетки, данные о погоде
+using TownMap = cache::LruCache<std::string, TownInfo>;               // Нормализованные названия городов, ячейки сетки
 
-    std::string ToString() const;
+// Счётчики запросов к внешним сервисам и запросов, объединённых с уже выполняющимися
+struct RequestStats {
+    uint64_t geocode_requests{};
+    uint64_t gazetteer_hits{};      // городов, найденных в локальном справочнике без запроса к geocode
+    uint64_t geocode_coalesced{};
+    uint64_t forecast_requests{};   // запрошено прогнозов (точек)
+    uint64_t forecast_coalesced{};
+    uint64_t forecast_batches{};    // выполнено запросов к open-meteo
+    uint64_t stale_served{};        // ответов устаревшими данными во время фонового обновления
+    uint64_t refreshed_ahead{};     // городов, обновлённых заранее
 };
 
-using MeteoMap = std::unordered_map<std::string, MeteoInfo>; // Города, данные о погоде
+// Параметры фонового обновления популярных городов
+struct RefreshSettings {
+    size_t top_towns{50};                       // сколько самых популярных городов обновлять заранее
+    std::chrono::seconds period{60};            // период проверки, обновления распределяются равномерно внутри периода
+    std::chrono::minutes lead{3};               // за сколько до устаревания обновлять данные
+    std::chrono::minutes stale_grace{15};       // сколько после устаревания можно отвечать старыми данными
+};
 
-class MeteoBot {
+// Параметры объединения запросов прогноза для разных точек
+struct BatchSettings {
+    std::chrono::milliseconds window{5};    // сколько ждать других запросов после первого запроса в пакете
+    size_t max_locations{50};               // максимальное количество точек в одном запросе
+};
+
+/* Сбор запросов прогноза в пакеты: open-meteo принимает списки координат через запятую
+ * и возвращает массив прогнозов в том же порядке */
+class ForecastBatcher {
     constexpr static char HOST[]{"api.open-meteo.com"};
-    constexpr static std::chrono::minutes OLD_DATA_TIMEOUT{15};
+    constexpr static int FORECAST_DAYS{2};
+
+public:
+    ForecastBatcher(boost::asio::any_io_executor executor,
+                    std::shared_ptr<https_pool::HttpsPool> pool,
+                    BatchSettings settings = {});
 
-    constexpr static char DEFAULT_TOWN[]{"%D0%BA%D0%B0%D0%B7%D0%B0%D0%BD%D1%8C"}; // казань
+    boost::asio::awaitable<MeteoInfo> Fetch(double latitude, double longitude);
+
+    uint64_t Batches() const noexcept;
+
+private:
+    struct Request {
+        Request(boost::asio::any_io_executor executor, double lat, double lon)
+            : latitude(lat), longitude(lon), done(std::move(executor)) {}
+
+        double latitude;
+        double longitude;
+        async_util::Event done;
+        std::optional<MeteoInfo> result;
+        std::exception_ptr error;
+    };
+    using Batch = std::vector<std::shared_ptr<Request>>;
+
+    boost::asio::awaitable<void> FlushAfterWindow(uint64_t batch_id);
+    boost::asio::awaitable<void> Flush(Batch batch);
+    boost::asio::awaitable<std::vector<MeteoInfo>> FetchBatch(const Batch& batch);
+
+    boost::asio::any_io_executor executor_;
+    std::shared_ptr<https_pool::HttpsPool> pool_;
+    BatchSettings settings_;
+    Batch pending_;             // запросы, ожидающие отправки
+    uint64_t batch_id_{};       // номер собираемого пакета
+    uint64_t batches_{};
+};
+
+struct MeteoSettings {
+    BatchSettings batch{};
+    RefreshSettings refresh{};
+    std::string gazetteer_file{};   // файл локального справочника городов, пустая строка - не используется
+    std::string snapshot_file{};    // файл снимка индекса названий и прогнозов, пустая строка - снимки не сохраняются
+    std::chrono::seconds snapshot_period{300};
+    double grid_resolution{0.1};    // шаг сетки в градусах, близкий к шагу сетки моделей open-meteo, > 0 (иначе конструктор MeteoBot бросает std::invalid_argument)
+    cache::CacheSettings forecast_cache{.max_entries = 20000,
+                                        .max_bytes = 64 * 1024 * 1024,
+                                        .ttl = std::chrono::hours{24}};
+    cache::CacheSettings town_cache{.max_entries = 100000,
+                                    .max_bytes = 32 * 1024 * 1024,
+                                    .ttl = std::chrono::hours{24 * 7}};
+};
+
+class MeteoBot {
+    constexpr static std::chrono::minutes OLD_DATA_TIMEOUT{15};
+    constexpr static uint32_t SNAPSHOT_MAGIC{0x504E534D};  // "MSNP"
+    constexpr static uint32_t SNAPSHOT_VERSION{3};
 
 public:
     constexpr static int HOUR_RESOLUTION{3};
 
-    MeteoBot(boost::asio::io_context& ioc);
+    MeteoBot(boost::asio::any_io_executor executor,
+             std::shared_ptr<https_pool::HttpsPool> pool,
+             MeteoSettings settings = {});
 
-    std::string GetWeather(std::string town);
+    // trace - трасса обработки сообщения (интервалы geocode, обновления прогноза, форматирования), может быть nullptr
+    boost::asio::awaitable<telega::ReplyPtr> GetWeather(std::string town, tracing::TracePtr trace = nullptr);
+    boost::asio::awaitable<void> RunRefresh(); // цикл фонового обновления популярных городов
+
+    /* Снимок кэшей для быстрого старта: индекс названий и прогнозы, которыми ещё можно отвечать
+     * LoadSnapshot вызывается до начала обработки запросов, SaveSnapshot - при завершении работы,
+     * RunSnapshots периодически сохраняет снимок в фоновом потоке */
+    void LoadSnapshot();
+    void SaveSnapshot();
+    boost::asio::awaitable<void> RunSnapshots();
+
+    RequestStats GetRequestStats() const noexcept;
+    cache::CacheStats GetCacheStats() const noexcept;
+    cache::CacheStats GetTownStats() const noexcept;
+    cache::CacheStats GetNotFoundStats() const noexcept;
 
 private:
-    void UpdateWeather(const std::string& town);
+    boost::asio::awaitable<TownInfo> ResolveTown(std::string key, std::string query, tracing::TracePtr trace);
+    // возвращает полученный прогноз: запись ячейки могла быть вытеснена из кэша за время запроса
+    boost::asio::awaitable<MeteoInfo> UpdateWeather(GridCell cell, tracing::TracePtr trace = nullptr);
+    boost::asio::awaitable<void> RefreshWeather(GridCell cell); // обновление в фоне, ошибки только логируются
+    std::vector<GridCell> SelectRefreshCandidates();
+    std::string SerializeSnapshot();
+    void WriteSnapshot(std::string data, uint64_t generation); // может выполняться в фоновом потоке
+
+    GridCell ToCell(double latitude, double longitude) const noexcept;
+    std::pair<double, double> CellCenter(GridCell cell) const noexcept; // широта и долгота центра ячейки
 
-    std::unique_ptr<https_sync::HttpsSyncClient> client_;
+    boost::asio::any_io_executor executor_;
+    std::shared_ptr<https_pool::HttpsPool> pool_;
     std::unique_ptr<geo::Geocode> geocode_;
+    std::unique_ptr<ForecastBatcher> batcher_;
+    MeteoSettings settings_;
+    normalize::Normalizer normalizer_;
     MeteoMap weather_;
+    TownMap towns_;
+    uint64_t stale_served_{};
+    uint64_t refreshed_ahead_{};
+
+    async_util::SingleFlight<std::string, std::optional<geo::GeoInfo>> geocode_flights_;    // ключ - нормализованное название
+    async_util::SingleFlight<GridCell, MeteoInfo, GridCellHash> forecast_flights_;          // ключ - ячейка сетки
+
+    uint64_t snapshot_generation_{};        // номер последнего созданного снимка
+    std::mutex snapshot_mutex_;
+    uint64_t snapshot_written_{};           // номер последнего записанного снимка, защищён snapshot_mutex_
+    boost::asio::thread_pool snapshot_writer_{1};   // запись снимков на диск вне io_context
 };
 
 namespace util {
 MeteoInfo ResponseProcess(const boost::json::object& msg);
+// Разбор ответа на запрос нескольких точек (массив прогнозов) или одной точки (объект)
+std::vector<MeteoInfo> ResponseProcessBatch(const boost::json::value& msg);
+/* Потоковый разбор того же ответа без построения дерева JSON: значения записываются сразу в массивы прогноза
+ * expected_locations и expected_points - ожидаемое количество точек и значений в каждом массиве (для резервирования)
+ * При ошибке разбора JSON выбрасывает boost::system::system_error */
+std::vector<MeteoInfo> ParseForecast(std::string_view body, size_t expected_locations = 1, size_t expected_points = 0);
+// Запись и чтение прогноза в двоичном виде (для снимка кэша)
+void SerializeForecast(file_util::BinaryWriter& writer, const MeteoInfo& info);
+MeteoInfo DeserializeForecast(file_util::BinaryReader& reader);
+// Загрузка локального справочника городов, nullptr - справочник не задан или не загружен
+std::shared_ptr<const gazetteer::Gazetteer> LoadGazetteer(const std::string& file_name);
+// Разбор строки вида "55.79, 49.12" (широта, долгота)
+std::optional<std::pair<double, double>> ParseCoordinates(std::string_view text);
 }
 
 }
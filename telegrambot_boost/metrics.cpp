@@ -0,0 +1,185 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+
+namespace metrics {
+
+/* -------- Histogram -------- */
+
+/* Значения меньше SUB_COUNT попадают в отдельные корзины, остальные - по старшему биту (степень двойки)
+ * и следующим SUB_BITS битам (линейное деление степени двойки на SUB_COUNT частей) */
+size_t Histogram::BucketIndex(uint64_t value) noexcept {
+    if (value < SUB_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    const int exponent = static_cast<int>(std::bit_width(value)) - 1;
+    if (exponent > MAX_EXPONENT) {
+        return BUCKETS - 1;
+    }
+    const int shift = exponent - SUB_BITS;
+    const uint64_t sub = (value >> shift) & (SUB_COUNT - 1);
+    return static_cast<size_t>(SUB_COUNT + (exponent - SUB_BITS) * SUB_COUNT + sub);
+}
+
+uint64_t Histogram::BucketUpperBound(size_t index) noexcept {
+    if (index < SUB_COUNT) {
+        return index;
+    }
+    const int exponent = static_cast<int>((index - SUB_COUNT) / SUB_COUNT) + SUB_BITS;
+    const uint64_t sub = (index - SUB_COUNT) % SUB_COUNT;
+    const int shift = exponent - SUB_BITS;
+    return ((SUB_COUNT + sub + 1) << shift) - 1;
+}
+
+void Histogram::Record(uint64_t value) noexcept {
+    buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::Count() const noexcept {
+    return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::Sum() const noexcept {
+    return sum_.load(std::memory_order_relaxed);
+}
+
+double Histogram::Scale() const noexcept {
+    return scale_;
+}
+
+/* Корзины читаются без блокировки, во время чтения могут добавляться новые значения:
+ * результат соответствует состоянию на какой-то момент чтения с точностью до нескольких записей */
+uint64_t Histogram::Quantile(double quantile) const noexcept {
+    std::array<uint64_t, BUCKETS> counts;
+    uint64_t total{0};
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total))));
+    uint64_t seen{0};
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return BucketUpperBound(i);
+        }
+    }
+    return BucketUpperBound(BUCKETS - 1);
+}
+
+/* -------- Registry -------- */
+
+Registry::Family& Registry::GetFamily(const std::string& name, Type type, std::string_view help) {
+    auto [it, inserted] = families_.try_emplace(name);
+    if (inserted) {
+        it->second.type = type;
+        it->second.help = help;
+    } else if (it->second.type != type) {
+        throw std::logic_error(std::format("Metric {} is already registered with another type", name));
+    }
+    return it->second;
+}
+
+Counter& Registry::GetCounter(const std::string& name, const std::string& labels, std::string_view help) {
+    std::lock_guard lock(mutex_);
+    auto& counter = GetFamily(name, Type::counter, help).counters[labels];
+    if (!counter) {
+        counter = std::make_unique<Counter>();
+    }
+    return *counter;
+}
+
+Histogram& Registry::GetHistogram(const std::string& name, const std::string& labels, std::string_view help,
+                                  double scale) {
+    std::lock_guard lock(mutex_);
+    auto& histogram = GetFamily(name, Type::summary, help).histograms[labels];
+    if (!histogram) {
+        histogram = std::make_unique<Histogram>(scale);
+    }
+    return *histogram;
+}
+
+namespace {
+
+std::string Series(const std::string& name, std::string_view labels, std::string_view extra = {}) {
+    std::string result = name;
+    if (!labels.empty() || !extra.empty()) {
+        result += '{';
+        result += labels;
+        if (!labels.empty() && !extra.empty()) {
+            result += ',';
+        }
+        result += extra;
+        result += '}';
+    }
+    return result;
+}
+
+}
+
+std::string Registry::Serialize() const {
+    constexpr static double QUANTILES[]{0.5, 0.9, 0.99};
+
+    std::lock_guard lock(mutex_);
+    std::string out;
+    for (const auto& [name, family] : families_) {
+        if (!family.help.empty()) {
+            out += std::format("# HELP {} {}\n", name, family.help);
+        }
+        out += std::format("# TYPE {} {}\n", name, family.type == Type::counter ? "counter" : "summary");
+        for (const auto& [labels, counter] : family.counters) {
+            out += std::format("{} {}\n", Series(name, labels), counter->Value());
+        }
+        for (const auto& [labels, histogram] : family.histograms) {
+            const double scale = histogram->Scale();
+            for (double quantile : QUANTILES) {
+                out += std::format("{} {}\n",
+                                   Series(name, labels, std::format("quantile=\"{}\"", quantile)),
+                                   static_cast<double>(histogram->Quantile(quantile)) * scale);
+            }
+            out += std::format("{} {}\n", Series(name + "_sum", labels),
+                               static_cast<double>(histogram->Sum()) * scale);
+            out += std::format("{} {}\n", Series(name + "_count", labels), histogram->Count());
+        }
+    }
+    return out;
+}
+
+Registry& Global() {
+    static Registry registry;
+    return registry;
+}
+
+const UpstreamMetrics& Upstream(const std::string& host) {
+    constexpr static char PHASE_NAME[]{"bot_upstream_phase_seconds"};
+    constexpr static char PHASE_HELP[]{"Upstream request phase latency"};
+
+    static std::mutex mutex;
+    static std::map<std::string, std::unique_ptr<UpstreamMetrics>> cache;
+
+    const std::string labels = std::format(R"(upstream="{}")", host);
+    std::lock_guard lock(mutex);
+    auto& upstream = cache[labels];
+    if (!upstream) {
+        auto& registry = Global();
+        upstream.reset(new UpstreamMetrics{
+            registry.GetHistogram(PHASE_NAME, labels + R"(,phase="connect")", PHASE_HELP),
+            registry.GetHistogram(PHASE_NAME, labels + R"(,phase="handshake")", PHASE_HELP),
+            registry.GetHistogram(PHASE_NAME, labels + R"(,phase="transfer")", PHASE_HELP),
+            registry.GetCounter("bot_upstream_requests_total", labels, "Upstream requests"),
+            registry.GetCounter("bot_upstream_errors_total", labels, "Upstream failed requests")
+        });
+    }
+    return *upstream;
+}
+
+}
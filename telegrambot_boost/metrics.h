@@ -0,0 +1,142 @@
+#pragma once
+/*
+ * Метрики работы бота в формате Prometheus (text exposition format 0.0.4)
+ * - Counter - счётчик на атомарной переменной, увеличение без блокировок
+ * - Histogram - гистограмма с логарифмически-линейными корзинами (как HDR Histogram: 16 корзин
+ *   на каждую степень двойки, относительная погрешность не более 6.25%), запись без блокировок.
+ *   Выводится как summary: квантили 0.5, 0.9, 0.99, сумма и количество
+ * Метрики регистрируются один раз (под мьютексом), ссылки на них остаются действительными
+ * до завершения программы, поэтому в часто вызываемом коде их стоит запоминать
+ *
+ * Использование:
+ *** static auto& requests = metrics::Global().GetCounter("bot_requests_total", R"(upstream="geocode")", "Requests");
+ *** requests.Inc();
+ *** auto& latency = metrics::Global().GetHistogram("bot_request_seconds", R"(upstream="geocode")", "Latency");
+ *** { metrics::ScopedTimer timer(latency); co_await ...; }
+ *** std::string text = metrics::Global().Serialize();
+ */
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace metrics {
+
+class Counter {
+public:
+    void Inc(uint64_t value = 1) noexcept {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t Value() const noexcept {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Histogram {
+    constexpr static int SUB_BITS{4};
+    constexpr static uint64_t SUB_COUNT{1 << SUB_BITS};
+    constexpr static int MAX_EXPONENT{40};  // значения больше 2^41 записываются в последнюю корзину
+    constexpr static size_t BUCKETS{SUB_COUNT + (MAX_EXPONENT - SUB_BITS + 1) * SUB_COUNT};
+
+public:
+    // scale - множитель при выводе (например, 1e-6 для значений в микросекундах, выводимых в секундах)
+    explicit Histogram(double scale = 1.0) noexcept : scale_(scale) {}
+
+    void Record(uint64_t value) noexcept;
+
+    uint64_t Count() const noexcept;
+    uint64_t Sum() const noexcept;
+    uint64_t Quantile(double quantile) const noexcept; // верхняя граница корзины, в которую попадает квантиль
+    double Scale() const noexcept;
+
+    static size_t BucketIndex(uint64_t value) noexcept;
+    static uint64_t BucketUpperBound(size_t index) noexcept;
+
+private:
+    const double scale_;
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+};
+
+// Запись длительности от создания до уничтожения в микросекундах
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram) noexcept
+        : histogram_(histogram)
+        , start_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        histogram_.Record(ElapsedMicroseconds());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    uint64_t ElapsedMicroseconds() const noexcept {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                         std::chrono::steady_clock::now() - start_).count());
+    }
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+class Registry {
+public:
+    /* name - имя метрики, labels - метки в формате Prometheus без фигурных скобок: upstream="x",phase="y"
+     * help выводится для семейства метрик, берётся из первой регистрации */
+    Counter& GetCounter(const std::string& name, const std::string& labels, std::string_view help = {});
+    // Для времени: значения в микросекундах, вывод в секундах
+    Histogram& GetHistogram(const std::string& name, const std::string& labels, std::string_view help = {},
+                            double scale = 1e-6);
+
+    std::string Serialize() const;
+
+private:
+    enum class Type {
+        counter,
+        summary
+    };
+
+    struct Family {
+        Type type;
+        std::string help;
+        std::map<std::string, std::unique_ptr<Counter>> counters;       // метки -> счётчик
+        std::map<std::string, std::unique_ptr<Histogram>> histograms;   // метки -> гистограмма
+    };
+
+    Family& GetFamily(const std::string& name, Type type, std::string_view help);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+};
+
+Registry& Global();
+
+/* Метрики обращений к внешнему серверу (upstream="host"):
+ * время фаз подключения и обмена, количество запросов и ошибок */
+struct UpstreamMetrics {
+    Histogram& connect;     // разрешение имени и TCP подключение
+    Histogram& handshake;   // TLS рукопожатие
+    Histogram& transfer;    // отправка запроса и получение ответа
+    Counter& requests;
+    Counter& errors;        // исключения и ответы с кодом, отличным от 200
+};
+
+// Набор метрик создаётся при первом обращении и кэшируется, ссылки действительны до завершения программы
+const UpstreamMetrics& Upstream(const std::string& host);
+
+}
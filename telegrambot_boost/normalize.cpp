@@ -0,0 +1,296 @@
+#include "normalize.h"
+
+#include <boost/algorithm/string/trim_all.hpp>
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+
+namespace normalize {
+
+namespace {
+
+constexpr char32_t INVALID{0xFFFFFFFF};
+
+struct CodePoint {
+    char32_t value{INVALID};
+    size_t size{1};     // длина последовательности в байтах
+};
+
+// Декодирование одного символа UTF-8, для некорректной последовательности value = INVALID, size = 1
+CodePoint Decode(std::string_view text, size_t pos) {
+    const auto byte = [&](size_t i) { return static_cast<unsigned char>(text[pos + i]); };
+    const unsigned char lead = byte(0);
+    if (lead < 0x80) {
+        return {lead, 1};
+    }
+    size_t size{};
+    char32_t value{};
+    if ((lead & 0xE0) == 0xC0) {
+        size = 2;
+        value = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        size = 3;
+        value = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        size = 4;
+        value = lead & 0x07;
+    } else {
+        return {};
+    }
+    if (pos + size > text.size()) {
+        return {};
+    }
+    for (size_t i = 1; i < size; ++i) {
+        if ((byte(i) & 0xC0) != 0x80) {
+            return {};
+        }
+        value = (value << 6) | (byte(i) & 0x3F);
+    }
+    return {value, size};
+}
+
+void Encode(char32_t value, std::string& out) {
+    if (value < 0x80) {
+        out += static_cast<char>(value);
+    } else if (value < 0x800) {
+        out += static_cast<char>(0xC0 | (value >> 6));
+        out += static_cast<char>(0x80 | (value & 0x3F));
+    } else if (value < 0x10000) {
+        out += static_cast<char>(0xE0 | (value >> 12));
+        out += static_cast<char>(0x80 | ((value >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (value & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (value >> 18));
+        out += static_cast<char>(0x80 | ((value >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((value >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (value & 0x3F));
+    }
+}
+
+char32_t Fold(char32_t value) {
+    if (value >= U'A' && value <= U'Z') {
+        return value + 0x20;
+    }
+    if (value == U'Ё' || value == U'ё') {
+        return U'е';
+    }
+    if (value >= U'А' && value <= U'Я') {
+        return value + 0x20;
+    }
+    if (value >= 0x0400 && value <= 0x040F) { // Ѐ-Џ
+        return value + 0x50;
+    }
+    if (value >= 0x00C0 && value <= 0x00DE && value != 0x00D7) { // À-Þ, кроме знака умножения
+        return value + 0x20;
+    }
+    return value;
+}
+
+// Транслитерация строчных букв а-я (индекс - смещение от 'а')
+constexpr std::array<std::string_view, 32> CYRILLIC_TO_LATIN{
+    "a", "b", "v", "g", "d", "e", "zh", "z", "i", "y", "k", "l", "m", "n", "o", "p",
+    "r", "s", "t", "u", "f", "kh", "ts", "ch", "sh", "shch", "", "y", "", "e", "yu", "ya"};
+
+// Тип населённого пункта в начале названия
+constexpr std::array<std::string_view, 14> PREFIXES{
+    "g", "gor", "gorod", "city", "pgt", "pos", "poselok", "posyolok", "selo", "s", "der", "derevnya",
+    "stanitsa", "town"};
+
+// Страна в конце названия
+constexpr std::array<std::string_view, 3> SUFFIXES{"rossiya", "russia", "rf"};
+
+// Страна отдельной частью (между запятыми)
+constexpr std::array<std::string_view, 5> COUNTRIES{
+    "rossiya", "russia", "rf", "rossiyskaya federatsiya", "russian federation"};
+
+// Встроенные псевдонимы: {псевдоним, каноническое название}
+constexpr std::array<std::pair<std::string_view, std::string_view>, 10> BUILTIN_ALIASES{{
+    {"moscow", "moskva"},
+    {"saint petersburg", "sankt peterburg"},
+    {"st petersburg", "sankt peterburg"},
+    {"petersburg", "sankt peterburg"},
+    {"spb", "sankt peterburg"},
+    {"piter", "sankt peterburg"},
+    {"питер", "sankt peterburg"},
+    {"спб", "sankt peterburg"},
+    {"rostov on don", "rostov na donu"},
+    {"archangel", "arkhangelsk"},
+}};
+
+bool IsVowel(char ch) {
+    return ch == 'a' || ch == 'e' || ch == 'o' || ch == 'u';
+}
+
+/* Упрощение вариантов транслитерации одного слова:
+ * - j перед гласной -> y (jaroslavl -> yaroslavl)
+ * - ye в начале слова -> e (yekaterinburg -> ekaterinburg, как при транслитерации "екатеринбург")
+ * - окончания iy, yy, ii, ij, yi -> y (nizhniy, nizhnii, nizhny -> nizhny) */
+void SimplifyWord(std::string& word) {
+    for (size_t i = 0; i + 1 < word.size(); ++i) {
+        if (word[i] == 'j' && IsVowel(word[i + 1])) {
+            word[i] = 'y';
+        }
+    }
+    if (word.size() > 2 && word.starts_with("ye")) {
+        word.erase(0, 1);
+    }
+    if (word.size() > 3) {
+        const std::string_view ending = std::string_view(word).substr(word.size() - 2);
+        if (ending == "iy" || ending == "yy" || ending == "ii" || ending == "ij" || ending == "yi") {
+            word.resize(word.size() - 2);
+            word += 'y';
+        }
+    }
+}
+
+// Транслитерация сложенной строки и разбиение на слова; знаки препинания разделяют слова, апострофы удаляются
+std::vector<std::string> SplitWords(std::string_view folded) {
+    std::vector<std::string> words(1);
+    for (size_t pos = 0; pos < folded.size();) {
+        const CodePoint cp = Decode(folded, pos);
+        if (cp.value == INVALID) {
+            words.back() += folded[pos];
+        } else if (cp.value >= U'а' && cp.value <= U'я') {
+            words.back() += CYRILLIC_TO_LATIN[cp.value - U'а'];
+        } else if (cp.value < 0x80) {
+            const char ch = static_cast<char>(cp.value);
+            if ((ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9')) {
+                words.back() += ch;
+            } else if (ch != '\'' && ch != '`' && !words.back().empty()) {
+                words.emplace_back();
+            }
+        } else {
+            Encode(cp.value, words.back());
+        }
+        pos += cp.size;
+    }
+    if (words.back().empty()) {
+        words.pop_back();
+    }
+    return words;
+}
+
+bool IsCountry(const std::string& part) {
+    return std::find(COUNTRIES.begin(), COUNTRIES.end(), part) != COUNTRIES.end();
+}
+
+// Ключ одной части названия (между запятыми): слова через пробел без типа населённого пункта и страны в конце
+std::string PartKey(std::string_view part) {
+    auto words = SplitWords(FoldCase(part));
+    for (auto& word : words) {
+        SimplifyWord(word);
+    }
+
+    const auto is_prefix = [](const std::string& word) {
+        return std::find(PREFIXES.begin(), PREFIXES.end(), word) != PREFIXES.end();
+    };
+    const auto is_suffix = [](const std::string& word) {
+        return std::find(SUFFIXES.begin(), SUFFIXES.end(), word) != SUFFIXES.end();
+    };
+    size_t first{0};
+    size_t last{words.size()};
+    while (last - first > 1 && is_prefix(words[first])) {
+        ++first;
+    }
+    while (last - first > 1 && is_suffix(words[last - 1])) {
+        --last;
+    }
+
+    std::string key;
+    for (size_t i = first; i < last; ++i) {
+        if (!key.empty()) {
+            key += ' ';
+        }
+        key += words[i];
+    }
+    return key;
+}
+
+}
+
+std::string FoldCase(std::string_view text) {
+    std::string result;
+    result.reserve(text.size());
+    for (size_t pos = 0; pos < text.size();) {
+        const CodePoint cp = Decode(text, pos);
+        if (cp.value == INVALID) {
+            result += text[pos];
+        } else {
+            Encode(Fold(cp.value), result);
+        }
+        pos += cp.size;
+    }
+    return result;
+}
+
+/* Части, состоящие только из страны, отбрасываются (если остаётся хотя бы одна часть), остальные части
+ * сохраняют порядок: "Россия, Казань" и "Россия, Москва" не должны давать один ключ */
+std::vector<std::string> KeyParts(std::string_view name) {
+    std::vector<std::string> parts;
+    bool has_place{false};
+    for (size_t begin = 0; begin <= name.size();) {
+        const size_t end = std::min(name.find(',', begin), name.size());
+        if (std::string key = PartKey(name.substr(begin, end - begin)); !key.empty()) {
+            has_place = has_place || !IsCountry(key);
+            parts.push_back(std::move(key));
+        }
+        begin = end + 1;
+    }
+    if (has_place) {
+        std::erase_if(parts, IsCountry);
+    }
+    return parts;
+}
+
+std::string BaseKey(std::string_view name) {
+    std::string key;
+    for (const auto& part : KeyParts(name)) {
+        if (!key.empty()) {
+            key += KEY_PART_SEPARATOR;
+        }
+        key += part;
+    }
+    return key;
+}
+
+/* -------- Normalizer -------- */
+
+Normalizer::Normalizer() {
+    for (const auto& [alias, canonical] : BUILTIN_ALIASES) {
+        AddAlias(alias, canonical);
+    }
+}
+
+void Normalizer::AddAlias(std::string_view alias, std::string_view canonical) {
+    std::string alias_key = BaseKey(alias);
+    std::string canonical_key = BaseKey(canonical);
+    if (!alias_key.empty() && !canonical_key.empty() && alias_key != canonical_key) {
+        aliases_.insert_or_assign(std::move(alias_key), std::move(canonical_key));
+    }
+}
+
+// Псевдонимы заменяются в каждой части: "Moscow, Russia" и "Москва" дают один ключ
+std::string Normalizer::Key(std::string_view name) const {
+    std::string key;
+    for (const auto& part : KeyParts(name)) {
+        if (!key.empty()) {
+            key += KEY_PART_SEPARATOR;
+        }
+        auto it = aliases_.find(part);
+        key += it != aliases_.end() ? it->second : part;
+    }
+    return key;
+}
+
+std::string Normalizer::Query(std::string_view name) {
+    std::string query = FoldCase(name);
+    boost::algorithm::trim_all(query);
+    return query;
+}
+
+size_t Normalizer::Aliases() const noexcept {
+    return aliases_.size();
+}
+
+}
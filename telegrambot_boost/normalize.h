@@ -0,0 +1,55 @@
+#pragma once
+/*
+ * Нормализация названий городов перед поиском в кэше и справочнике
+ * Разные написания одного города приводятся к одному ключу:
+ *** "Moscow", "moskva", "москва", "г. Москва", "Москва, Россия" -> "moskva"
+ * 1) приведение к строчным буквам с учётом кириллицы (UTF-8), ё -> е
+ * 2) разбиение на части по запятым: часть, состоящая только из страны, отбрасывается, остальные части
+ *    (город, регион) остаются в ключе в исходном порядке - "Россия, Казань" -> "kazan",
+ *    "Татарстан, Казань" -> "tatarstan, kazan" (разные города одной страны или региона не дают один ключ)
+ * 3) транслитерация кириллицы в латиницу, знаки препинания и дефисы заменяются пробелами
+ * 4) упрощение вариантов транслитерации (окончания -ий/-iy/-yy -> -y, j -> y перед гласными)
+ * 5) удаление типа населённого пункта в начале ("г.", "город", "пос." ...) и страны в конце
+ * 6) замена каждой части по индексу псевдонимов (английские названия, сокращения) на канонический ключ
+ *
+ * Ключ используется только для поиска, для запроса в geocode используется Query - исходная строка
+ * в нижнем регистре (уточнение региона помогает geocode найти нужный город)
+ *
+ * Использование:
+ *** normalize::Normalizer normalizer;
+ *** std::string key = normalizer.Key("г. Москва"); // "moskva"
+ */
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace normalize {
+
+constexpr static char KEY_PART_SEPARATOR[]{", "};    // разделитель частей ключа
+
+class Normalizer {
+public:
+    Normalizer(); // заполняет индекс встроенными псевдонимами
+
+    // alias и canonical нормализуются, повторное добавление псевдонима заменяет прежний
+    void AddAlias(std::string_view alias, std::string_view canonical);
+
+    std::string Key(std::string_view name) const;
+    static std::string Query(std::string_view name);
+
+    size_t Aliases() const noexcept;
+
+private:
+    std::unordered_map<std::string, std::string> aliases_; // нормализованный псевдоним -> канонический ключ
+};
+
+// UTF-8: латиница, кириллица и Latin-1 в нижний регистр, ё -> е. Некорректные байты не изменяются
+std::string FoldCase(std::string_view text);
+// Ключ без учёта псевдонимов (шаги 1-5)
+std::string BaseKey(std::string_view name);
+// Части ключа без учёта псевдонимов (BaseKey - они же через KEY_PART_SEPARATOR)
+std::vector<std::string> KeyParts(std::string_view name);
+
+}
@@ -0,0 +1,205 @@
+#include "numscan.h"
+
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NUM_SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NUM_SCAN_SSE2
+#endif
+
+namespace num_scan {
+
+namespace {
+
+bool IsSpace(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+enum class Token { value, empty, bad };
+
+bool IsDigit(char c) noexcept {
+    return c >= '0' && c <= '9';
+}
+
+/* Проверка грамматики числа JSON: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+ * from_chars принимает больше (inf, nan, "1.", ".5", "01"), такие числа разбирает обычный парсер JSON и сообщает об ошибке */
+bool IsJsonNumber(const char* begin, const char* end) noexcept {
+    const auto digits = [&begin, end] {
+        const char* start = begin;
+        while (begin != end && IsDigit(*begin)) {
+            ++begin;
+        }
+        return begin != start;
+    };
+    if (begin != end && *begin == '-') {
+        ++begin;
+    }
+    if (begin != end && *begin == '0') {
+        ++begin;
+    } else if (!digits()) {
+        return false;
+    }
+    if (begin != end && *begin == '.') {
+        ++begin;
+        if (!digits()) {
+            return false;
+        }
+    }
+    if (begin != end && (*begin == 'e' || *begin == 'E')) {
+        ++begin;
+        if (begin != end && (*begin == '+' || *begin == '-')) {
+            ++begin;
+        }
+        if (!digits()) {
+            return false;
+        }
+    }
+    return begin == end;
+}
+
+// Разбор одного элемента массива между разделителями, пробелы вокруг допустимы
+Token ParseToken(const char* begin, const char* end, float& value) noexcept {
+    while (begin != end && IsSpace(*begin)) {
+        ++begin;
+    }
+    while (begin != end && IsSpace(*(end - 1))) {
+        --end;
+    }
+    if (begin == end) {
+        return Token::empty;
+    }
+    if (end - begin == 4 && std::memcmp(begin, "null", 4) == 0) {
+        value = std::numeric_limits<float>::quiet_NaN();
+        return Token::value;
+    }
+    if (!IsJsonNumber(begin, end)) {
+        return Token::bad;
+    }
+    const auto [ptr, ec] = std::from_chars(begin, end, value);
+    return ec == std::errc{} && ptr == end ? Token::value : Token::bad;
+}
+
+/* Поиск разделителей блоками: маска блока содержит по биту на каждую ',' и ']', биты выбираются по одному
+ * Блок выходит за конец буфера только в хвосте, хвост проверяется побайтно */
+template <bool Vectorized>
+class DelimiterScanner {
+public:
+#if defined(NUM_SCAN_AVX2)
+    constexpr static size_t BLOCK{Vectorized ? 32 : 16};
+#else
+    constexpr static size_t BLOCK{16};
+#endif
+
+    DelimiterScanner(const char* begin, const char* end) noexcept
+        : begin_(begin)
+        , size_(static_cast<size_t>(end - begin)) {
+        Load();
+    }
+
+    // Следующая ',' или ']', nullptr - до конца буфера разделителей нет
+    const char* Next() noexcept {
+        while (mask_ == 0) {
+            offset_ += BLOCK;
+            if (offset_ >= size_) {
+                return nullptr;
+            }
+            Load();
+        }
+        const int index = std::countr_zero(mask_);
+        mask_ &= mask_ - 1;
+        return begin_ + offset_ + index;
+    }
+
+private:
+    void Load() noexcept {
+        const char* block = begin_ + offset_;
+        if constexpr (Vectorized) {
+            if (size_ - offset_ >= BLOCK) {
+#if defined(NUM_SCAN_AVX2)
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+                const __m256i delimiters = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(',')),
+                                                           _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(']')));
+                mask_ = static_cast<uint32_t>(_mm256_movemask_epi8(delimiters));
+                return;
+#elif defined(NUM_SCAN_SSE2)
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+                const __m128i delimiters = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(',')),
+                                                        _mm_cmpeq_epi8(chunk, _mm_set1_epi8(']')));
+                mask_ = static_cast<uint32_t>(_mm_movemask_epi8(delimiters));
+                return;
+#endif
+            }
+        }
+        const size_t count = size_ - offset_ < BLOCK ? size_ - offset_ : BLOCK;
+        mask_ = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (block[i] == ',' || block[i] == ']') {
+                mask_ |= uint32_t{1} << i;
+            }
+        }
+    }
+
+    const char* begin_;
+    size_t size_;
+    size_t offset_{};
+    uint32_t mask_{};
+};
+
+template <bool Vectorized>
+const char* Decode(const char* begin, const char* end, std::vector<float>& values) {
+    if (begin == end || *begin != '[') {
+        return nullptr;
+    }
+    const size_t initial_size = values.size();
+    DelimiterScanner<Vectorized> scanner(begin + 1, end);
+    const char* token = begin + 1;
+    while (const char* delimiter = scanner.Next()) {
+        float value{};
+        const Token result = ParseToken(token, delimiter, value);
+        if (result == Token::value) {
+            values.push_back(value);
+        } else if (result == Token::bad || *delimiter == ',' || values.size() != initial_size) {
+            break;  // пустой элемент допустим только как "[]"
+        }
+        if (*delimiter == ']') {
+            return delimiter + 1;
+        }
+        token = delimiter + 1;
+    }
+    values.resize(initial_size);
+    return nullptr;
+}
+
+}
+
+const char* DecodeFloatArray(const char* begin, const char* end, std::vector<float>& values) {
+#if defined(NUM_SCAN_AVX2) || defined(NUM_SCAN_SSE2)
+    return Decode<true>(begin, end, values);
+#else
+    return Decode<false>(begin, end, values);
+#endif
+}
+
+const char* DecodeFloatArrayScalar(const char* begin, const char* end, std::vector<float>& values) {
+    return Decode<false>(begin, end, values);
+}
+
+std::string_view Isa() noexcept {
+#if defined(NUM_SCAN_AVX2)
+    return "avx2";
+#elif defined(NUM_SCAN_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+}
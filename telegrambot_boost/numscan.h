@@ -0,0 +1,32 @@
+#pragma once
+/*
+ * Быстрый разбор массивов чисел JSON (массивы прогноза open-meteo: temperature_2m, rain, snowfall)
+ * Разделители (запятые и закрывающая скобка) ищутся блоками по 32 (AVX2) или 16 (SSE2) байт,
+ * каждое число разбирается std::from_chars сразу во float. null записывается как NaN (нет данных)
+ * Без SSE2 (не x86) используется поиск разделителей без векторных инструкций, AVX2 включается
+ * при сборке с -mavx2 (/arch:AVX2)
+ *
+ * Подходят только плоские массивы из чисел и null; для остальных (строки, вложенные массивы и объекты,
+ * ошибки) функции возвращают nullptr, и массив нужно разбирать обычным парсером JSON
+ * Числа проверяются по грамматике JSON: "1.", ".5", "01", "+1", inf и nan не принимаются
+ *
+ * Использование:
+ *** std::vector<float> values;
+ *** const char* next = num_scan::DecodeFloatArray(text.data(), text.data() + text.size(), values); // text = "[1.5,null,-0.3]"
+ */
+#include <string_view>
+#include <vector>
+
+namespace num_scan {
+
+/* begin указывает на '[', значения дописываются в конец values
+ * Возвращает указатель на символ после ']', nullptr - массив не подходит (values при этом не меняется) */
+const char* DecodeFloatArray(const char* begin, const char* end, std::vector<float>& values);
+
+// То же без векторных инструкций (для сравнения в микробенчмарках)
+const char* DecodeFloatArrayScalar(const char* begin, const char* end, std::vector<float>& values);
+
+// Набор инструкций, с которым собран DecodeFloatArray: "avx2", "sse2" или "scalar"
+std::string_view Isa() noexcept;
+
+}
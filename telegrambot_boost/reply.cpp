@@ -0,0 +1,48 @@
+#include "logger.h"
+#include "reply.h"
+
+namespace telega {
+
+Reply::Reply(std::string_view text) {
+    constexpr static char TEXT_FIELD[]{"text"};
+
+    body_tail_.reserve(text.size() + 16);
+    body_tail_ += ",\"";
+    body_tail_ += TEXT_FIELD;
+    body_tail_ += "\":";
+    logger::util::AppendJsonString(body_tail_, text);
+    body_tail_ += '}';
+}
+
+std::string Reply::Body(std::string_view chat_id, std::string_view method) const {
+    constexpr static char METHOD_FIELD[]{"method"};
+    constexpr static char CHAT_ID_FIELD[]{"chat_id"};
+
+    std::string body;
+    body.reserve(body_tail_.size() + chat_id.size() + method.size() + 32);
+    body += '{';
+    if (!method.empty()) {
+        body += '"';
+        body += METHOD_FIELD;
+        body += "\":";
+        logger::util::AppendJsonString(body, method);
+        body += ',';
+    }
+    body += '"';
+    body += CHAT_ID_FIELD;
+    body += "\":";
+    logger::util::AppendJsonString(body, chat_id);
+    body += body_tail_;
+    return body;
+}
+
+size_t Reply::ApproxBytes() const noexcept {
+    constexpr static size_t CONTROL_BLOCK{2 * sizeof(void*) + 2 * sizeof(long)};
+    return sizeof(Reply) + CONTROL_BLOCK + body_tail_.capacity();
+}
+
+ReplyPtr MakeReply(std::string_view text) {
+    return std::make_shared<const Reply>(text);
+}
+
+}
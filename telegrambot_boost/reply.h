@@ -0,0 +1,34 @@
+#pragma once
+/*
+ * Готовый ответ пользователю telegram
+ * Окончание тела sendMessage с текстом записывается в JSON один раз при создании,
+ * при отправке в него подставляется только chat_id. Ответ не изменяется, поэтому один ответ
+ * может отправляться в разные чаты и храниться в кэше (meteo::MeteoInfo::replies)
+ *
+ * Использование:
+ *** telega::ReplyPtr reply = telega::MakeReply("Погода в Казани ...");
+ *** std::string body = reply->Body(chat_id); // {"chat_id":"...","text":"Погода в Казани ..."}
+ */
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace telega {
+
+class Reply {
+public:
+    explicit Reply(std::string_view text);
+
+    // {"chat_id":"...","text":"..."}, с непустым method - ещё и "method" (ответ на webhook)
+    std::string Body(std::string_view chat_id, std::string_view method = {}) const;
+    size_t ApproxBytes() const noexcept;    // вместе с блоком управления shared_ptr
+
+private:
+    std::string body_tail_;     // ,"text":"..."}
+};
+
+using ReplyPtr = std::shared_ptr<const Reply>;
+ReplyPtr MakeReply(std::string_view text);
+
+}
@@ -1,6 +1,10 @@
 #include "logger.h"
+#include "metrics.h"
 #include "telegrambot.h"
 
+#include <algorithm>
+#include <format>
+#include <string_view>
 #include <utility>
 
 #include <boost/beast.hpp>
@@ -12,23 +16,81 @@ using tcp = asio::ip::tcp;
 namespace http = boost::beast::http;
 namespace json = boost::json;
 
+namespace {
+
+// Опрос getUpdates, формирование и отправка ответов
+struct BotMetrics {
+    metrics::Counter& polls_ok;
+    metrics::Counter& polls_empty;
+    metrics::Counter& polls_failed;
+    metrics::Histogram& poll_updates;   // сообщений в ответе на getUpdates
+    metrics::Histogram& answer_latency; // формирование ответа (callback)
+    metrics::Histogram& send_latency;   // отправка ответа (sendMessage)
+    metrics::Counter& reply_errors;
+};
+
+const BotMetrics& Metrics() {
+    constexpr static char POLLS[]{"bot_telegram_polls_total"};
+    auto& registry = metrics::Global();
+    static const BotMetrics bot_metrics{
+        registry.GetCounter(POLLS, R"(result="ok")", "getUpdates requests by result"),
+        registry.GetCounter(POLLS, R"(result="empty")"),
+        registry.GetCounter(POLLS, R"(result="failed")"),
+        registry.GetHistogram("bot_telegram_poll_updates", "", "Updates per getUpdates response", 1.0),
+        registry.GetHistogram("bot_reply_answer_seconds", "", "Reply preparation latency"),
+        registry.GetHistogram("bot_reply_send_seconds", "", "sendMessage latency including pool wait"),
+        registry.GetCounter("bot_reply_errors_total", "", "Replies failed to prepare or send")
+    };
+    return bot_metrics;
+}
+
+}
+
 namespace util {
-/* Обрабатываем ответ от телеграмм
+/* Обрабатываем одно обновление от телеграмм
  * Ищем:
- * - сообщение пользователя (/result/message/text) - предполагается название города
- * - id чата (/result/message/chat/id)
- * объект result - это массив сообщений от разных чатов (пользователей)
- * На выходе массив пар {chat_id, town} и last_update_id */
-std::pair<ResponseResults, int64_t> ResponseProcess(const boost::json::object& msg) {
-    constexpr static char OK_FIELD[]{"ok"};
-    constexpr static char RESULT_FIELD[]{"result"};
-    constexpr static char UPDATE_ID_FIELD[]{"update_id"};
+ * - сообщение пользователя (/message/text) - предполагается название города
+ * - id чата (/message/chat/id)
+ * На выходе пара {chat_id, town}, если обновление - сообщение из чата */
+std::optional<std::pair<std::string, std::string>> UpdateProcess(const boost::json::value& update) {
     constexpr static char MESSAGE_FIELD[]{"message"};
     constexpr static char CHAT_FIELD[]{"chat"};
     constexpr static char ID_FIELD[]{"id"};
 
     const std::string base_town{"Казань"};
 
+    boost::system::error_code ec;
+    std::string text_path = "/" + std::string(MESSAGE_FIELD) +
+                            "/" + std::string(TEXT_FIELD);
+    auto* text_val = update.find_pointer(text_path, ec);
+    std::string town = (text_val && text_val->is_string()) ? (std::string(text_val->as_string())) :
+                           base_town;
+
+    // присланная геопозиция передаётся как строка "широта,долгота"
+    auto* lat_val = update.find_pointer("/" + std::string(MESSAGE_FIELD) + "/location/latitude", ec);
+    auto* lon_val = update.find_pointer("/" + std::string(MESSAGE_FIELD) + "/location/longitude", ec);
+    if (lat_val && lon_val && lat_val->is_number() && lon_val->is_number()) {
+        town = std::format("{},{}", lat_val->to_number<double>(), lon_val->to_number<double>());
+    }
+
+    std::string chat_path = "/" + std::string(MESSAGE_FIELD) +
+                            "/" + std::string(CHAT_FIELD) +
+                            "/" + std::string(ID_FIELD);
+    auto* chat_val = update.find_pointer(chat_path, ec);
+    if (chat_val && chat_val->is_int64()) {
+        return std::pair{std::to_string(chat_val->as_int64()), std::move(town)};
+    }
+    return std::nullopt;
+}
+
+/* Обрабатываем ответ от телеграмм на getUpdates
+ * объект result - это массив обновлений от разных чатов (пользователей), каждое разбирается UpdateProcess
+ * На выходе массив {update_id, chat_id, town} и last_update_id */
+std::pair<ResponseResults, int64_t> ResponseProcess(const boost::json::object& msg) {
+    constexpr static char OK_FIELD[]{"ok"};
+    constexpr static char RESULT_FIELD[]{"result"};
+    constexpr static char UPDATE_ID_FIELD[]{"update_id"};
+
     if (!msg.at(OK_FIELD).as_bool()) {
         logger::LogError(std::string("Request failure. RESPONSE: ") + json::serialize(msg),
                          "TelegramBot. ResponseProcess");
@@ -39,114 +101,332 @@ std::pair<ResponseResults, int64_t> ResponseProcess(const boost::json::object& m
     }
     ResponseResults towns_for_chats;
     int64_t last_update_id{};
-    json::array res_values = msg.at(RESULT_FIELD).as_array();
+    const json::array& res_values = msg.at(RESULT_FIELD).as_array();
     for (const auto& res : res_values) {
+        int64_t update_id{};
         if (res.as_object().contains(UPDATE_ID_FIELD) && res.as_object().at(UPDATE_ID_FIELD).is_int64()) {
-            last_update_id = res.as_object().at(UPDATE_ID_FIELD).as_int64();
+            update_id = res.as_object().at(UPDATE_ID_FIELD).as_int64();
+            last_update_id = update_id;
         }
-
-        boost::system::error_code ec;
-        std::string text_path = "/" + std::string(MESSAGE_FIELD) +
-                                "/" + std::string(TEXT_FIELD);
-        auto* text_val = res.find_pointer(text_path, ec);
-        std::string town = (text_val && text_val->is_string()) ? (std::string(text_val->as_string())) :
-                               base_town;
-
-        std::string chat_path = "/" + std::string(MESSAGE_FIELD) +
-                                "/" + std::string(CHAT_FIELD) +
-                                "/" + std::string(ID_FIELD);
-        auto* chat_val = res.find_pointer(chat_path, ec);
-        if (chat_val && chat_val->is_int64()) {
-            towns_for_chats.push_back({std::to_string(chat_val->as_int64()), town});
+        if (auto chat_town = UpdateProcess(res)) {
+            towns_for_chats.push_back({.update_id = update_id,
+                                       .chat_id = std::move(chat_town->first),
+                                       .town = std::move(chat_town->second)});
         }
     }
     return std::pair{towns_for_chats, last_update_id};
 }
 }
 
-TelegramBot::TelegramBot(boost::asio::any_io_executor& executor,
-                         const std::string& token,
-                         GetAnswerFunc callback)
-    : bot_token_(token)
-    , api_url_(URL_BASE + token)
-    , client_(std::make_unique<https_client::HttpsClient>(executor))
-    , callback_(callback) {}
-
-TelegramBot::~TelegramBot() {
-    client_->Disconnect();
+double PollStats::EmptyRatio() const noexcept {
+    return polls ? static_cast<double>(empty_polls) / static_cast<double>(polls) : 0.0;
 }
 
-boost::asio::awaitable<void> TelegramBot::Connect() {
-    co_await client_->Connect(HOST);
-    co_return;
+TelegramBot::TelegramBot(boost::asio::any_io_executor executor,
+                         std::shared_ptr<https_pool::HttpsPool> pool,
+                         const std::string& token,
+                         GetAnswerFunc callback,
+                         PollSettings poll_settings,
+                         ReplySettings reply_settings)
+    : executor_(std::move(executor))
+    , bot_token_(token)
+    , api_url_(URL_BASE + token)
+    , pool_(std::move(pool))
+    , callback_(callback)
+    , poll_settings_(std::move(poll_settings))
+    , reply_slots_(std::make_unique<async_util::Semaphore>(executor_, reply_settings.max_parallel)) {
+    if (!poll_settings_.offset_file.empty()) {
+        offset_checkpoint_ = std::make_unique<file_util::Checkpoint>(poll_settings_.offset_file);
+    }
 }
 
-boost::asio::awaitable<void> TelegramBot::Reconnect() {
-    using namespace std::chrono_literals;
-    client_->Disconnect();
-    co_await Connect();
-    co_return;
-}
+TelegramBot::~TelegramBot() = default;
 
 /* Основной цикл работы бота
- * Проверяем подключение к серверу перед началом работы
+ * Подключения к серверу берутся из пула, при ошибке запроса делаем паузу и повторяем
  * В цикле:
- * - Запрашиваем обновления от сервера (getUpdates)
- * - Разбираем ответ сервера
- * - Отправляем сообщения по всем чатам, запросившим информацию */
+ * - Запрашиваем обновления от сервера (getUpdates) в режиме long polling: сервер держит запрос
+ *   до poll_settings_.timeout секунд, пока не появятся обновления, поэтому таймаут чтения
+ *   ответа увеличен на это время
+ * - Разбираем ответ сервера, сообщения запоминаем как ещё не отвеченные (unanswered_)
+ * - Раздаём сообщения по очередям чатов, ответы формируются и отправляются параллельно (см. Dispatch)
+ * В контрольную точку (запись на диск в фоновом потоке) попадает номер обновления, на которое и на все
+ * предыдущие уже ответили (SaveOffset), поэтому после перезапуска с восстановленным смещением telegram
+ * присылает повторно все обновления, оставшиеся без ответа, в том числе ждавшие в очередях чатов
+ * После остановки (Stop) обновления из незавершённого опроса не обрабатываются (они придут повторно),
+ * ждём завершения обработки всех поставленных в очередь сообщений */
 boost::asio::awaitable<void> TelegramBot::Start() {
     constexpr static char OFFSET_FIELD[]{"offset"};
-    if (!client_->IsConnected()) {
-        logger::LogError(std::string("Must be connected before running start"),
-                         "TelegramBot::Start");
-        co_return;
-    }
+    constexpr static char TIMEOUT_FIELD[]{"timeout"};
+    constexpr static char LIMIT_FIELD[]{"limit"};
+    constexpr static char ALLOWED_UPDATES_FIELD[]{"allowed_updates"};
+
+    const auto poll_timeout = std::chrono::seconds(poll_settings_.timeout) + https_client::HttpsClient::DEFAULT_TIMEOUT;
+    json::array allowed_updates(poll_settings_.allowed_updates.begin(), poll_settings_.allowed_updates.end());
+
     do_work_ = true;
+    // getUpdates не работает, пока у бота установлен webhook
+    co_await MakeRequest(DELETE_WEBHOOK_METHOD, json::serialize(json::object{}));
+
     while (do_work_) {
         try {
+            LogPollStats();
             json::object payload{};
             if (last_update_id_ != 0) {
                 payload[OFFSET_FIELD] = last_update_id_ + 1;
             }
-            auto response = co_await MakeRequest(GET_METHOD, json::serialize(payload));
+            payload[TIMEOUT_FIELD] = poll_settings_.timeout;
+            payload[LIMIT_FIELD] = poll_settings_.limit;
+            payload[ALLOWED_UPDATES_FIELD] = allowed_updates;
+
+            ++poll_stats_.polls;
+            const auto poll_start = std::chrono::steady_clock::now();
+            auto response = co_await MakeRequest(GET_METHOD, json::serialize(payload), poll_timeout);
+            const auto poll_end = std::chrono::steady_clock::now();
             if (response.empty()) {
-                co_await Reconnect();
+                ++poll_stats_.failed_polls;
+                Metrics().polls_failed.Inc();
+                asio::steady_timer delay(executor_, ERROR_DELAY);
+                co_await delay.async_wait(asio::use_awaitable);
                 continue;
             }
             auto [answer, last_update_id] = util::ResponseProcess(response);
+            if (last_update_id == 0) {
+                ++poll_stats_.empty_polls;
+                Metrics().polls_empty.Inc();
+                continue;
+            }
+            if (!do_work_) {
+                break;
+            }
+            Metrics().polls_ok.Inc();
+            Metrics().poll_updates.Record(answer.size());
             last_update_id_ = last_update_id;
-            for (const auto& [chat_id, town] : answer) {
-                auto [it, is_inserted] = chats_.insert(chat_id);
-                if (is_inserted) {
-                    logger::LogInfo(std::string("New chat created: ") + *it,
-                                    "TelegramBot::Start");
+            for (const auto& update : answer) {
+                if (update.update_id != 0) {
+                    unanswered_.insert(update.update_id);
                 }
-                co_await SendMessage(chat_id, callback_(std::string(town)));
+            }
+            SaveOffset();
+            poll_stats_.updates += answer.size();
+            for (auto& update : answer) {
+                RegisterChat(update.chat_id);
+                auto trace = tracing::NewTrace("update");
+                if (trace) {
+                    trace->Arg("chat", tracing::Pseudonym(update.chat_id));
+                    trace->Arg("text_length", std::to_string(update.town.size()));
+                    trace->AddSpan(GET_METHOD, poll_start, poll_end);
+                }
+                co_await Dispatch(update.chat_id, {.town = std::move(update.town),
+                                                   .trace = std::move(trace),
+                                                   .update_id = update.update_id});
             }
         } catch (const std::exception& err) {
             logger::LogError(err.what(), "TelegramBot::Start");
         }
     }
+    while (!chat_queues_.empty()) {
+        asio::steady_timer delay(executor_, std::chrono::milliseconds{100});
+        co_await delay.async_wait(asio::use_awaitable);
+    }
+}
+
+void TelegramBot::RestoreOffset(int64_t last_update_id) {
+    last_update_id_ = last_update_id;
+    saved_update_id_ = last_update_id;
+}
+
+void TelegramBot::Answered(int64_t update_id) {
+    if (update_id != 0 && unanswered_.erase(update_id)) {
+        SaveOffset();
+    }
+}
+
+// Обновления без сообщений (и номера до первого неотвеченного) считаются обработанными сразу
+void TelegramBot::SaveOffset() {
+    const int64_t answered = unanswered_.empty() ? last_update_id_ : *unanswered_.begin() - 1;
+    if (offset_checkpoint_ && answered != saved_update_id_) {
+        saved_update_id_ = answered;
+        offset_checkpoint_->Save(answered);
+    }
+}
+
+/* Если у чата уже есть обработчик, сообщение добавляется в конец его очереди.
+ * Иначе ждём свободный слот (так же ограничивается и скорость чтения новых обновлений)
+ * и запускаем для чата отдельную корутину-обработчик */
+boost::asio::awaitable<void> TelegramBot::Dispatch(const std::string& chat_id, PendingMessage message) {
+    if (auto it = chat_queues_.find(chat_id); it != chat_queues_.end()) {
+        it->second.push_back(std::move(message));
+        co_return;
+    }
+    auto slot = co_await reply_slots_->Acquire();
+    chat_queues_[chat_id].push_back(std::move(message));
+    asio::co_spawn(executor_, ProcessChat(chat_id, std::move(slot)), asio::detached);
+}
+
+// Обработчик чата: по очереди формирует и отправляет ответы, пока очередь чата не опустеет
+// slot освобождается при завершении обработчика
+boost::asio::awaitable<void> TelegramBot::ProcessChat(std::string chat_id, async_util::Semaphore::Guard slot) {
+    while (true) {
+        auto it = chat_queues_.find(chat_id);
+        if (it->second.empty()) {
+            chat_queues_.erase(it);
+            break;
+        }
+        PendingMessage message = std::move(it->second.front());
+        it->second.pop_front();
+        if (message.trace) {
+            message.trace->AddSpan("queue", message.queued, std::chrono::steady_clock::now());
+        }
+        try {
+            ReplyPtr reply;
+            {
+                metrics::ScopedTimer timer(Metrics().answer_latency);
+                tracing::Span span(message.trace, "answer");
+                reply = co_await callback_(std::move(message.town), message.trace);
+            }
+            metrics::ScopedTimer timer(Metrics().send_latency);
+            co_await SendMessage(chat_id, *reply, message.trace);
+        } catch (const std::exception& err) {
+            Metrics().reply_errors.Inc();
+            LOG_LIMITED(logger::Level::error, 10, err.what(), "TelegramBot::ProcessChat");
+        }
+        // сообщение, на которое не удалось ответить, тоже считается обработанным,
+        // иначе оно приходило бы повторно после каждого перезапуска
+        Answered(message.update_id);
+    }
+}
+
+/* Получение обновлений через webhook
+ * - регистрируем адрес webhook в API telegram (setWebhook)
+ * - запускаем встроенный сервер, который принимает обновления и сразу отвечает пользователю
+ * Порядок ответов внутри чата при max_connections > 1 определяется порядком доставки обновлений telegram */
+boost::asio::awaitable<void> TelegramBot::StartWebhook(WebhookSettings settings) {
+    constexpr static char OK_FIELD[]{"ok"};
+    constexpr static char URL_FIELD[]{"url"};
+    constexpr static char SECRET_TOKEN_FIELD[]{"secret_token"};
+    constexpr static char MAX_CONNECTIONS_FIELD[]{"max_connections"};
+    constexpr static char ALLOWED_UPDATES_FIELD[]{"allowed_updates"};
+
+    webhook_settings_ = std::move(settings);
+    do_work_ = true;
+
+    json::object payload;
+    payload[URL_FIELD] = webhook_settings_.url;
+    payload[MAX_CONNECTIONS_FIELD] = webhook_settings_.max_connections;
+    payload[ALLOWED_UPDATES_FIELD] = json::array(webhook_settings_.allowed_updates.begin(),
+                                                 webhook_settings_.allowed_updates.end());
+    if (!webhook_settings_.secret_token.empty()) {
+        payload[SECRET_TOKEN_FIELD] = webhook_settings_.secret_token;
+    }
+    auto response = co_await MakeRequest(SET_WEBHOOK_METHOD, json::serialize(payload));
+    if (response.empty() || !response.contains(OK_FIELD) || !response.at(OK_FIELD).as_bool()) {
+        logger::LogError(std::string("setWebhook failure. RESPONSE: ") + json::serialize(response),
+                         "TelegramBot::StartWebhook");
+        co_return;
+    }
+    logger::LogInfo(std::string("Webhook set: ") + webhook_settings_.url, "TelegramBot::StartWebhook");
+
+    webhook_server_ = std::make_unique<http_server::HttpServer>(executor_, webhook_settings_.server,
+                                                                [this](http_server::Request req) {
+                                                                    return HandleWebhook(std::move(req));
+                                                                });
+    if (!do_work_) {
+        co_return; // остановлен во время setWebhook
+    }
+    co_await webhook_server_->Run();
 }
 
 void TelegramBot::Stop() {
     do_work_ = false;
+    if (webhook_server_) {
+        webhook_server_->Stop();
+    }
 }
 
-// формирование и отправка сообщения в указанный чат
-boost::asio::awaitable<void> TelegramBot::SendMessage(const std::string& chat_id,
-                                                      const std::string& text) {
-    constexpr static char CHAT_ID_FIELD[]{"chat_id"};
+const PollStats& TelegramBot::GetPollStats() const noexcept {
+    return poll_stats_;
+}
 
-    json::object payload;
-    payload[CHAT_ID_FIELD] = chat_id;
-    payload[TEXT_FIELD] = text;
-    co_await MakeRequest(SEND_METHOD, json::serialize(payload));
+// Периодический вывод статистики опроса: доля пустых ответов показывает, сколько времени бот простаивает
+void TelegramBot::LogPollStats() {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - stats_logged_ < STATS_LOG_INTERVAL) {
+        return;
+    }
+    stats_logged_ = now;
+    logger::LogInfo(std::format("Poll stats: polls={} empty={} failed={} updates={} empty_ratio={:.3f}",
+                                poll_stats_.polls, poll_stats_.empty_polls, poll_stats_.failed_polls,
+                                poll_stats_.updates, poll_stats_.EmptyRatio()),
+                    "TelegramBot::LogPollStats");
+}
+
+/* Тело запроса - одно обновление (Update), разбирается так же, как элементы ответа getUpdates.
+ * Ответ пользователю передаётся прямо в ответе на запрос telegram в виде вызова метода sendMessage,
+ * что экономит отдельный запрос к API */
+boost::asio::awaitable<http_server::Response> TelegramBot::HandleWebhook(http_server::Request req) {
+    constexpr static char SECRET_HEADER[]{"X-Telegram-Bot-Api-Secret-Token"};
+    constexpr static char UPDATE_ID_FIELD[]{"update_id"};
+
+    if (req.method() != http::verb::post || std::string_view(req.target()) != webhook_settings_.path) {
+        co_return http_server::MakeResponse(http::status::not_found);
+    }
+    if (!webhook_settings_.secret_token.empty() && std::string_view(req[SECRET_HEADER]) != webhook_settings_.secret_token) {
+        logger::LogError("Wrong webhook secret token", "TelegramBot::HandleWebhook");
+        co_return http_server::MakeResponse(http::status::forbidden);
+    }
+
+    std::optional<std::pair<std::string, std::string>> chat_town;
+    try {
+        auto update = json::parse(req.body());
+        if (update.is_object() && update.as_object().contains(UPDATE_ID_FIELD) &&
+            update.as_object().at(UPDATE_ID_FIELD).is_int64()) {
+            last_update_id_ = std::max(last_update_id_, update.as_object().at(UPDATE_ID_FIELD).as_int64());
+        }
+        chat_town = util::UpdateProcess(update);
+    } catch (const std::exception& err) {
+        logger::LogError(err.what(), "TelegramBot::HandleWebhook");
+        co_return http_server::MakeResponse(http::status::bad_request);
+    }
+    if (!chat_town) {
+        co_return http_server::MakeResponse(http::status::ok);
+    }
+
+    auto& [chat_id, town] = *chat_town;
+    RegisterChat(chat_id);
+    auto trace = tracing::NewTrace("webhook update");
+    if (trace) {
+        trace->Arg("chat", tracing::Pseudonym(chat_id));
+        trace->Arg("text_length", std::to_string(town.size()));
+    }
+    ReplyPtr reply;
+    {
+        tracing::Span span(trace, "answer");
+        reply = co_await callback_(std::move(town), trace);
+    }
+    co_return http_server::MakeResponse(http::status::ok, reply->Body(chat_id, SEND_METHOD), "application/json");
+}
+
+void TelegramBot::RegisterChat(const std::string& chat_id) {
+    auto [it, is_inserted] = chats_.insert(chat_id);
+    if (is_inserted) {
+        logger::LogInfo(std::string("New chat created: ") + *it,
+                        "TelegramBot::RegisterChat");
+    }
+}
+
+// отправка ответа в указанный чат, тело запроса собирается из готового ответа без построения JSON
+boost::asio::awaitable<void> TelegramBot::SendMessage(const std::string& chat_id,
+                                                      const Reply& reply,
+                                                      tracing::TracePtr trace) {
+    tracing::Span span(trace, SEND_METHOD);
+    co_await MakeRequest(SEND_METHOD, reply.Body(chat_id));
 }
 
 // формирование запроса к API telegram
 boost::asio::awaitable<json::object> TelegramBot::MakeRequest(const std::string& method,
-                                                              const std::string& payload) {
+                                                              std::string payload,
+                                                              std::chrono::seconds timeout) {
     const std::string content_type{"application/json"};
     const int http_version{11};
     try {
@@ -158,22 +438,63 @@ boost::asio::awaitable<json::object> TelegramBot::MakeRequest(const std::string&
         req.body() = std::move(payload);
         req.prepare_payload();
 
-        std::string res = co_await client_->Exchange(req);
+        std::string res = co_await pool_->Exchange(HOST, std::move(req), timeout);
         auto res_obj = json::parse(res).as_object();
         co_return res_obj;
-    } catch (const std::exception&) {
+    } catch (const std::exception& err) {
+        LOG_LIMITED(logger::Level::error, 10, err.what(), "TelegramBot::MakeRequest");
         co_return json::object{};
     }
 }
 
+namespace {
+
+// Остановка бота по событию stop (bot удерживается до события или до уничтожения io_context)
+boost::asio::awaitable<void> StopOnEvent(std::shared_ptr<async_util::Event> stop, std::shared_ptr<TelegramBot> bot) {
+    co_await stop->Wait();
+    bot->Stop();
+}
+
+}
 
 // Функция запуска бота
-boost::asio::awaitable<void> RunTelegramBot(const std::string& token, GetAnswerFunc callback) {
+boost::asio::awaitable<void> RunTelegramBot(const std::string& token,
+                                            GetAnswerFunc callback,
+                                            std::shared_ptr<https_pool::HttpsPool> pool,
+                                            PollSettings poll_settings,
+                                            ReplySettings reply_settings,
+                                            std::shared_ptr<async_util::Event> stop) {
     auto executor = co_await asio::this_coro::executor;
 
-    TelegramBot t_bot(executor, token, callback);
-    co_await t_bot.Connect();
-    co_await t_bot.Start();
+    std::optional<int64_t> last_update_id;
+    if (!poll_settings.offset_file.empty()) {
+        last_update_id = file_util::Checkpoint::Load(poll_settings.offset_file);
+    }
+    auto t_bot = std::make_shared<TelegramBot>(executor, std::move(pool), token, callback, std::move(poll_settings),
+                                               reply_settings);
+    if (last_update_id) {
+        t_bot->RestoreOffset(*last_update_id);
+        logger::LogInfo(std::format("Restored getUpdates offset: {}", *last_update_id + 1), "RunTelegramBot");
+    }
+    if (stop) {
+        asio::co_spawn(executor, StopOnEvent(std::move(stop), t_bot), asio::detached);
+    }
+    co_await t_bot->Start();
+}
+
+// Функция запуска бота в режиме webhook
+boost::asio::awaitable<void> RunTelegramWebhook(const std::string& token,
+                                                GetAnswerFunc callback,
+                                                std::shared_ptr<https_pool::HttpsPool> pool,
+                                                WebhookSettings webhook_settings,
+                                                std::shared_ptr<async_util::Event> stop) {
+    auto executor = co_await asio::this_coro::executor;
+
+    auto t_bot = std::make_shared<TelegramBot>(executor, std::move(pool), token, callback);
+    if (stop) {
+        asio::co_spawn(executor, StopOnEvent(std::move(stop), t_bot), asio::detached);
+    }
+    co_await t_bot->StartWebhook(std::move(webhook_settings));
 }
 
 }
@@ -5,75 +5,192 @@
  *
  * Создание и запуск:
  *** boost::asio::io_context ioc;
+ *** auto pool = std::make_shared<https_pool::HttpsPool>(ioc.get_executor());
  *** boost::asio::co_spawn(ioc,
- ***                       telega::RunTelegramBot(token, callback_function),
+ ***                       telega::RunTelegramBot(token, callback_function, pool),
  ***                       [](std::exception_ptr err) {
  ***                            if(err) {
  ***                                std::rethrow_exception(err);
  ***                            }
  ***                       });
  *** ioc.run();
- * callback_function имеет сигнатуру std::string(std::string) - она принимает на вход строку (сообщение от пользователя)
- * и возвращает остроку (сообщение пользователю)
+ * Если задан poll_settings.offset_file, номер последнего обновления, на которое (и на все предыдущие) уже ответили,
+ * сохраняется на диск и восстанавливается при запуске: после перезапуска telegram присылает повторно
+ * только обновления, оставшиеся без ответа
+ * Для остановки передаётся событие stop (async_util::Event): после stop->Set() бот перестаёт получать обновления,
+ * отвечает на уже полученные, и корутина RunTelegramBot (RunTelegramWebhook) завершается
+ * Вместо опроса getUpdates обновления можно получать через webhook (встроенный HTTP(S) сервер):
+ *** boost::asio::co_spawn(ioc, telega::RunTelegramWebhook(token, callback_function, pool, webhook_settings), ...);
+ * callback_function имеет сигнатуру boost::asio::awaitable<telega::ReplyPtr>(std::string, tracing::TracePtr) - она принимает
+ * на вход строку (сообщение от пользователя) и трассу его обработки (nullptr - трассировка выключена)
+ * и асинхронно возвращает ответ пользователю (telega::MakeReply(text)). Ответ можно хранить и отправлять повторно:
+ * текст в нём уже записан в JSON, и тело sendMessage собирается подстановкой chat_id
  */
 
 #include <boost/asio/co_spawn.hpp>
 #include <boost/json.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
-#include "httpsclient.h"
+#include "asyncutil.h"
+#include "fileutil.h"
+#include "httpserver.h"
+#include "httpspool.h"
+#include "reply.h"
+#include "tracing.h"
 
 namespace telega {
 
-using GetAnswerFunc = std::function<std::string(std::string&&)>;
-using ResponseResults = std::vector<std::pair<std::string, std::string>>; // вектор пар (chat_id, town)
+using GetAnswerFunc = std::function<boost::asio::awaitable<ReplyPtr>(std::string, tracing::TracePtr)>;
+
+// Сообщение из чата, полученное через getUpdates
+struct ChatUpdate {
+    int64_t update_id{};
+    std::string chat_id;
+    std::string town;
+};
+using ResponseResults = std::vector<ChatUpdate>;
 
 constexpr static char TEXT_FIELD[]{"text"};
 
+// Параметры long polling запроса getUpdates
+struct PollSettings {
+    int timeout{25};                                        // сколько секунд сервер ждёт новых обновлений
+    int limit{100};                                         // максимальное количество обновлений в ответе
+    std::vector<std::string> allowed_updates{"message"};    // типы обновлений, которые нужно получать
+    std::string offset_file{};                              // файл контрольной точки last_update_id, пустая строка - не сохраняется
+};
+
+// Параметры приёма обновлений через webhook
+struct WebhookSettings {
+    std::string url{};                                      // публичный https адрес, на который telegram отправляет обновления
+    std::string path{"/webhook"};                           // путь, по которому сервер принимает обновления
+    std::string secret_token{};                             // сверяется с заголовком X-Telegram-Bot-Api-Secret-Token
+    int max_connections{40};                                // максимальное количество одновременных подключений от telegram
+    std::vector<std::string> allowed_updates{"message"};    // типы обновлений, которые нужно получать
+    http_server::ServerSettings server{};                   // адрес, порт и сертификат встроенного сервера
+};
+
+// Параметры обработки сообщений
+struct ReplySettings {
+    size_t max_parallel{32};    // максимальное количество чатов, сообщения которых обрабатываются одновременно
+};
+
+// Статистика опроса сервера
+struct PollStats {
+    uint64_t polls{};           // выполнено запросов getUpdates
+    uint64_t empty_polls{};     // запросов, завершившихся по таймауту без обновлений
+    uint64_t failed_polls{};    // запросов, завершившихся ошибкой
+    uint64_t updates{};         // получено сообщений
+
+    double EmptyRatio() const noexcept;
+};
+
+// Сообщение в очереди чата и трасса его обработки
+struct PendingMessage {
+    std::string town;
+    tracing::TracePtr trace;
+    int64_t update_id{};    // 0 - обновление получено не через getUpdates
+    std::chrono::steady_clock::time_point queued{std::chrono::steady_clock::now()};
+};
+
 class TelegramBot {
     constexpr static char URL_BASE[]{"https://api.telegram.org/bot"};
     constexpr static char HOST[]{"api.telegram.org"};
 
     constexpr static char GET_METHOD[]{"getUpdates"};
     constexpr static char SEND_METHOD[]{"sendMessage"};
+    constexpr static char SET_WEBHOOK_METHOD[]{"setWebhook"};
+    constexpr static char DELETE_WEBHOOK_METHOD[]{"deleteWebhook"};
 
-    static constexpr int TIMEOUT = 30;
+    constexpr static std::chrono::seconds ERROR_DELAY{1};       // пауза перед повтором запроса после ошибки
+    constexpr static std::chrono::minutes STATS_LOG_INTERVAL{5}; // периодичность вывода статистики опроса в лог
 
 public:
-    explicit TelegramBot(boost::asio::any_io_executor& executor,
+    explicit TelegramBot(boost::asio::any_io_executor executor,
+                         std::shared_ptr<https_pool::HttpsPool> pool,
                          const std::string& token,
-                         GetAnswerFunc callback);
+                         GetAnswerFunc callback,
+                         PollSettings poll_settings = {},
+                         ReplySettings reply_settings = {});
     ~TelegramBot();
 
-    boost::asio::awaitable<void> Connect();
-    boost::asio::awaitable<void> Start();
+    boost::asio::awaitable<void> Start();                                   // получение обновлений через getUpdates
+    boost::asio::awaitable<void> StartWebhook(WebhookSettings settings);    // получение обновлений через webhook
     void Stop();
 
+    const PollStats& GetPollStats() const noexcept;
+    void RestoreOffset(int64_t last_update_id); // продолжить получение обновлений после last_update_id
+
 private:
-    boost::asio::awaitable<void> SendMessage(const std::string& chat_id, const std::string& msg); // формирование и отправка сообщения в указанный чат
-    boost::asio::awaitable<boost::json::object> MakeRequest(const std::string& method, const std::string& payload); // формирование запроса к API telegram
-    boost::asio::awaitable<void> Reconnect();
+    boost::asio::awaitable<void> SendMessage(const std::string& chat_id, const Reply& reply,
+                                             tracing::TracePtr trace = nullptr); // отправка ответа в указанный чат
+    boost::asio::awaitable<boost::json::object> MakeRequest(const std::string& method, std::string payload,
+                                                            std::chrono::seconds timeout = https_client::HttpsClient::DEFAULT_TIMEOUT); // формирование запроса к API telegram
+    void LogPollStats();
+    void Answered(int64_t update_id);   // ответ на обновление отправлен (или не удался)
+    void SaveOffset();                  // запись в контрольную точку последнего обновления, на которое уже ответили
+
+    // Постановка сообщения в очередь чата. Сообщения одного чата обрабатываются строго по порядку,
+    // разные чаты обрабатываются параллельно (не более reply_settings_.max_parallel)
+    boost::asio::awaitable<void> Dispatch(const std::string& chat_id, PendingMessage message);
+    boost::asio::awaitable<void> ProcessChat(std::string chat_id, async_util::Semaphore::Guard slot);
 
+    // обработка обновления, присланного telegram на webhook, ответ пользователю отправляется в ответе на запрос
+    boost::asio::awaitable<http_server::Response> HandleWebhook(http_server::Request req);
+    void RegisterChat(const std::string& chat_id);
+
+    boost::asio::any_io_executor executor_;
     std::string bot_token_;
     std::string api_url_;
-    std::unique_ptr<https_client::HttpsClient> client_;
+    std::shared_ptr<https_pool::HttpsPool> pool_;
     GetAnswerFunc callback_;      // функция формирования ответа пользователю
-    int64_t last_update_id_{};    // последнее обработанное обновление от Telegram API, для исключения повторных обновлений
+    int64_t last_update_id_{};    // последнее полученное обновление от Telegram API, для исключения повторных обновлений
+    std::set<int64_t> unanswered_; // полученные через getUpdates обновления, на которые ещё не ответили
+    int64_t saved_update_id_{};   // последнее значение, записанное в offset_checkpoint_
+    std::unique_ptr<file_util::Checkpoint> offset_checkpoint_; // сохранение отвеченных обновлений для продолжения после перезапуска
+    PollSettings poll_settings_;
+    PollStats poll_stats_;
+    std::chrono::steady_clock::time_point stats_logged_{std::chrono::steady_clock::now()};
+
+    std::unique_ptr<async_util::Semaphore> reply_slots_;
+    std::unordered_map<std::string, std::deque<PendingMessage>> chat_queues_; // необработанные сообщения чатов, у которых есть обработчик
+
+    WebhookSettings webhook_settings_;
+    std::unique_ptr<http_server::HttpServer> webhook_server_;
 
     std::set<std::string> chats_;
     bool do_work_{false};
 };
 
 boost::asio::awaitable<void> RunTelegramBot(const std::string& token,
-                                            GetAnswerFunc callback);
+                                            GetAnswerFunc callback,
+                                            std::shared_ptr<https_pool::HttpsPool> pool,
+                                            PollSettings poll_settings = {},
+                                            ReplySettings reply_settings = {},
+                                            std::shared_ptr<async_util::Event> stop = nullptr);
+
+boost::asio::awaitable<void> RunTelegramWebhook(const std::string& token,
+                                                GetAnswerFunc callback,
+                                                std::shared_ptr<https_pool::HttpsPool> pool,
+                                                WebhookSettings webhook_settings,
+                                                std::shared_ptr<async_util::Event> stop = nullptr);
 
 namespace util {
-/* Обработка сообщений от API telegram
- * Возвращает вектор пар (chat_id, town) и last_update_id */
+/* Обработка одного обновления от API telegram
+ * Возвращает пару (chat_id, town), если обновление содержит сообщение из чата */
+std::optional<std::pair<std::string, std::string>> UpdateProcess(const boost::json::value& update);
+/* Обработка ответа API telegram на getUpdates
+ * Возвращает сообщения из чатов (update_id, chat_id, town) и last_update_id */
 std::pair<ResponseResults, int64_t> ResponseProcess(const boost::json::object& msg);
 }
 }
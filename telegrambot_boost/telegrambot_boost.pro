@@ -14,21 +14,40 @@ linux {
     LIBS += -lcrypto -lssl
 }
 SOURCES += \
+    asyncutil.cpp \
+    fileutil.cpp \
+    gazetteer.cpp \
     geocode.cpp \
     httpsclient.cpp \
-    httpssyncclient.cpp \
+    httpserver.cpp \
+    httpspool.cpp \
     logger.cpp \
     main.cpp \
     meteobot.cpp \
-    telegrambot.cpp
+    metrics.cpp \
+    normalize.cpp \
+    numscan.cpp \
+    reply.cpp \
+    telegrambot.cpp \
+    tracing.cpp
 
 HEADERS += \
+    asyncutil.h \
+    fileutil.h \
+    gazetteer.h \
     geocode.h \
     httpsclient.h \
-    httpssyncclient.h \
+    httpserver.h \
+    httpspool.h \
     logger.h \
+    lrucache.h \
     meteobot.h \
-    telegrambot.h
+    metrics.h \
+    normalize.h \
+    numscan.h \
+    reply.h \
+    telegrambot.h \
+    tracing.h
 
 DISTFILES += \
     README.md
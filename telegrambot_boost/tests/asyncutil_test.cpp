@@ -0,0 +1,103 @@
+#include "../asyncutil.h"
+
+#include <boost/asio.hpp>
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Flights = async_util::SingleFlight<std::string, int>;
+
+// Запрос, завершающийся через несколько миллисекунд: остальные вызовы Run успевают к нему присоединиться
+boost::asio::awaitable<int> SlowFetch(int& calls, int value, bool fail = false) {
+    ++calls;
+    boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::milliseconds{5});
+    co_await timer.async_wait(boost::asio::use_awaitable);
+    if (fail) {
+        throw std::runtime_error("fetch failed");
+    }
+    co_return value;
+}
+
+// Результат одного вызова Run: значение или текст исключения
+struct Outcome {
+    std::optional<int> value;
+    std::string error;
+};
+
+void Spawn(boost::asio::io_context& ioc, Flights& flights, std::string key, int& calls, int value, bool fail,
+           std::vector<Outcome>& outcomes) {
+    boost::asio::co_spawn(ioc, [&flights, key, &calls, value, fail, &outcomes]() -> boost::asio::awaitable<void> {
+        Outcome outcome;
+        try {
+            outcome.value = co_await flights.Run(key, [&calls, value, fail] { return SlowFetch(calls, value, fail); });
+        } catch (const std::exception& err) {
+            outcome.error = err.what();
+        }
+        outcomes.push_back(outcome);
+    }, boost::asio::detached);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(asyncutil)
+
+BOOST_AUTO_TEST_CASE(waiters_get_leader_result) {
+    boost::asio::io_context ioc;
+    Flights flights(ioc.get_executor());
+    int calls{};
+    std::vector<Outcome> outcomes;
+    for (int i = 0; i < 5; ++i) {
+        Spawn(ioc, flights, "kazan", calls, 42 + i, false, outcomes);   // ожидающие не выполняют свой запрос
+    }
+    Spawn(ioc, flights, "moskva", calls, 7, false, outcomes);
+    ioc.run();
+
+    BOOST_TEST(calls == 2);
+    BOOST_TEST(flights.Executed() == 2);
+    BOOST_TEST(flights.Coalesced() == 4);
+    BOOST_TEST(flights.InFlight() == 0);
+    BOOST_REQUIRE(outcomes.size() == 6);
+    int kazan{};
+    for (const auto& outcome : outcomes) {
+        BOOST_REQUIRE(outcome.value.has_value());
+        BOOST_TEST((*outcome.value == 42 || *outcome.value == 7));
+        kazan += *outcome.value == 42;
+    }
+    BOOST_TEST(kazan == 5);
+}
+
+BOOST_AUTO_TEST_CASE(exception_reaches_all_waiters) {
+    boost::asio::io_context ioc;
+    Flights flights(ioc.get_executor());
+    int calls{};
+    std::vector<Outcome> outcomes;
+    for (int i = 0; i < 3; ++i) {
+        Spawn(ioc, flights, "kazan", calls, 1, true, outcomes);
+    }
+    ioc.run();
+
+    BOOST_TEST(calls == 1);
+    BOOST_REQUIRE(outcomes.size() == 3);
+    for (const auto& outcome : outcomes) {
+        BOOST_TEST(!outcome.value.has_value());
+        BOOST_TEST(outcome.error == "fetch failed");
+    }
+    BOOST_TEST(flights.InFlight() == 0);
+
+    // ошибка не запоминается: следующий вызов выполняет запрос заново
+    outcomes.clear();
+    Spawn(ioc, flights, "kazan", calls, 2, false, outcomes);
+    ioc.restart();
+    ioc.run();
+    BOOST_TEST(calls == 2);
+    BOOST_REQUIRE(outcomes.size() == 1);
+    BOOST_TEST((outcomes.front().value == std::optional<int>{2}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+#include "../fileutil.h"
+
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Временный каталог теста, удаляется вместе с содержимым
+struct TempDir {
+    TempDir() {
+        std::filesystem::create_directories(path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+
+    std::string File(const std::string& name) const {
+        return (path / name).string();
+    }
+
+    std::filesystem::path path{std::filesystem::temp_directory_path() /
+                               ("telegrambot_tests_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()))};
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE(fileutil)
+
+BOOST_FIXTURE_TEST_CASE(checkpoint_round_trip, TempDir) {
+    const std::string file = File("offset.txt");
+    BOOST_TEST(!file_util::Checkpoint::Load(file).has_value());
+    {
+        file_util::Checkpoint checkpoint(file);
+        checkpoint.Save(123456789012);
+    }   // деструктор дожидается записи
+    BOOST_TEST((file_util::Checkpoint::Load(file) == std::optional<int64_t>{123456789012}));
+    {
+        file_util::Checkpoint checkpoint(file);
+        checkpoint.Save(-5);
+    }
+    BOOST_TEST((file_util::Checkpoint::Load(file) == std::optional<int64_t>{-5}));
+}
+
+BOOST_FIXTURE_TEST_CASE(checkpoint_rejects_damaged_file, TempDir) {
+    const std::string file = File("offset.txt");
+    for (const char* text : {"", "abc\n", "12abc\n", " 12\n"}) {
+        std::ofstream(file, std::ios::trunc) << text;
+        BOOST_TEST(!file_util::Checkpoint::Load(file).has_value(), text);
+    }
+}
+
+// Частые Save объединяются: записывается последнее значение, записей меньше, чем вызовов Save
+BOOST_FIXTURE_TEST_CASE(checkpoint_coalesces_saves, TempDir) {
+    constexpr static int64_t SAVES{1000};
+    const std::string file = File("offset.txt");
+    uint64_t writes{};
+    {
+        file_util::Checkpoint checkpoint(file);
+        for (int64_t value = 1; value <= SAVES; ++value) {
+            checkpoint.Save(value);
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+        while (file_util::Checkpoint::Load(file) != std::optional<int64_t>{SAVES} &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        writes = checkpoint.Writes();
+    }
+    BOOST_TEST((file_util::Checkpoint::Load(file) == std::optional<int64_t>{SAVES}));
+    BOOST_TEST(writes >= 1u);
+    BOOST_TEST(writes < static_cast<uint64_t>(SAVES));
+}
+
+BOOST_AUTO_TEST_CASE(binary_reader_bounds) {
+    file_util::BinaryWriter writer;
+    writer.Put<uint32_t>(7);
+    writer.PutString("kazan");
+    file_util::BinaryReader reader(writer.Data());
+    BOOST_TEST(reader.Get<uint32_t>() == 7u);
+    BOOST_TEST(reader.GetString() == "kazan");
+    BOOST_TEST(reader.AtEnd());
+    BOOST_CHECK_THROW(reader.Get<uint8_t>(), std::out_of_range);
+
+    // длина строки больше оставшихся данных
+    file_util::BinaryReader truncated(writer.Data().substr(0, writer.Data().size() - 1));
+    truncated.Get<uint32_t>();
+    BOOST_CHECK_THROW(truncated.GetString(), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
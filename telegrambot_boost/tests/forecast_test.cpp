@@ -0,0 +1,180 @@
+#include "../meteobot.h"
+
+#include <boost/json.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "."
+#endif
+
+namespace {
+
+using meteo::Forecast;
+using meteo::MeteoInfo;
+
+std::string ReadPayload(const std::string& name) {
+    const auto path = std::filesystem::path(TEST_DATA_DIR) / "payloads" / name;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open " + path.string());
+    }
+    std::ostringstream data;
+    data << in.rdbuf();
+    return data.str();
+}
+
+bool SameValue(float lhs, float rhs) {
+    return std::isnan(lhs) ? std::isnan(rhs) : lhs == rhs;
+}
+
+// Прогнозы совпадают, кроме времени получения
+void CheckSame(const MeteoInfo& streamed, const MeteoInfo& tree) {
+    BOOST_TEST(streamed.valid == tree.valid);
+    BOOST_TEST(streamed.units == tree.units);   // единицы измерения - экземпляры общей таблицы
+    BOOST_TEST(streamed.forecast.Start() == tree.forecast.Start());
+    BOOST_TEST(streamed.forecast.Step() == tree.forecast.Step());
+    BOOST_TEST(streamed.forecast.UtcOffset() == tree.forecast.UtcOffset());
+    BOOST_REQUIRE(streamed.forecast.Size() == tree.forecast.Size());
+    const auto lhs = streamed.forecast.Block();
+    const auto rhs = tree.forecast.Block();
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        BOOST_TEST(SameValue(lhs[i], rhs[i]), "value " << i << ": " << lhs[i] << " != " << rhs[i]);
+    }
+}
+
+// Потоковый разбор и разбор дерева JSON дают одинаковый результат
+std::vector<MeteoInfo> ParseBoth(std::string_view body) {
+    auto streamed = meteo::util::ParseForecast(body);
+    const auto tree = meteo::util::ResponseProcessBatch(boost::json::parse(body));
+    BOOST_REQUIRE(streamed.size() == tree.size());
+    for (size_t i = 0; i < streamed.size(); ++i) {
+        BOOST_TEST_CONTEXT("location " << i) {
+            CheckSame(streamed[i], tree[i]);
+        }
+    }
+    return streamed;
+}
+
+std::vector<float> Values(const MeteoInfo& info, Forecast::Variable variable) {
+    const auto values = info.forecast.Values(variable);
+    return {values.begin(), values.end()};
+}
+
+constexpr static char LOCATION[]{
+    R"({"utc_offset_seconds":10800,"hourly_units":{"time":"unixtime","temperature_2m":"°C"},)"
+    R"("hourly":{"time":[1700000000,1700010800,1700021600],"temperature_2m":[1.5,-2,3],"rain":[0,0.5,null]}})"};
+
+}
+
+BOOST_AUTO_TEST_SUITE(forecast)
+
+BOOST_AUTO_TEST_CASE(recorded_responses) {
+    for (const char* name : {"forecast_2d.json", "forecast_16d.json", "forecast_batch50_2d.json"}) {
+        BOOST_TEST_CONTEXT(name) {
+            const std::string body = ReadPayload(name);
+            const auto weather = ParseBoth(body);
+            BOOST_REQUIRE(!weather.empty());
+            for (const auto& info : weather) {
+                BOOST_TEST(info.valid);
+                BOOST_TEST(info.forecast.Size() != 0);
+            }
+            // резервирование по ожидаемым размерам не меняет результат
+            const auto reserved = meteo::util::ParseForecast(body, weather.size(), weather.front().forecast.Size());
+            BOOST_REQUIRE(reserved.size() == weather.size());
+            for (size_t i = 0; i < weather.size(); ++i) {
+                CheckSame(reserved[i], weather[i]);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(object_and_array) {
+    BOOST_TEST(ParseBoth(LOCATION).size() == 1);
+    BOOST_TEST(ParseBoth(std::string{"["} + LOCATION + "," + LOCATION + "]").size() == 2);
+    BOOST_TEST(ParseBoth("[]").empty());
+
+    // не объект в массиве пакета - точка без прогноза, порядок точек сохраняется
+    const auto weather = ParseBoth(std::string{"[1,"} + LOCATION + ",null,\"x\",[2]]");
+    BOOST_REQUIRE(weather.size() == 5);
+    BOOST_TEST(!weather[0].valid);
+    BOOST_TEST(weather[1].valid);
+    BOOST_TEST(!weather[2].valid);
+    BOOST_TEST(!weather[3].valid);
+    BOOST_TEST(!weather[4].valid);
+}
+
+BOOST_AUTO_TEST_CASE(integers_and_null) {
+    const auto weather = ParseBoth(LOCATION);
+    BOOST_REQUIRE(weather.size() == 1);
+    const MeteoInfo& info = weather.front();
+    BOOST_TEST(info.valid);
+    BOOST_TEST(info.forecast.Start() == 1700000000);
+    BOOST_TEST(info.forecast.Step() == 10800);
+    BOOST_TEST(info.forecast.UtcOffset() == 10800);
+    BOOST_REQUIRE(info.forecast.Size() == 3);
+    BOOST_TEST(Values(info, Forecast::Variable::temperature) == std::vector<float>({1.5f, -2.0f, 3.0f}),
+               boost::test_tools::per_element());
+    const auto rain = Values(info, Forecast::Variable::rain);
+    BOOST_TEST(rain[0] == 0.0f);
+    BOOST_TEST(rain[1] == 0.5f);
+    BOOST_TEST(std::isnan(rain[2]));
+    // нет массива - нет данных
+    for (float value : Values(info, Forecast::Variable::snowfall)) {
+        BOOST_TEST(std::isnan(value));
+    }
+}
+
+// Массив, который не разбирает num_scan, разбирается парсером JSON с тем же результатом
+BOOST_AUTO_TEST_CASE(strings_in_hourly_array) {
+    const auto weather = ParseBoth(
+        R"({"hourly":{"time":[0,3600,7200],"temperature_2m":[1,"2",3],"rain":[1,[2],3],"snowfall":[true,{},1]}})");
+    BOOST_REQUIRE(weather.size() == 1);
+    // не число - нет данных на этот час, остальные значения остаются на своих местах
+    for (const auto variable : {Forecast::Variable::temperature, Forecast::Variable::rain}) {
+        const auto values = Values(weather.front(), variable);
+        BOOST_REQUIRE(values.size() == 3);
+        BOOST_TEST(values[0] == 1.0f);
+        BOOST_TEST(std::isnan(values[1]));
+        BOOST_TEST(values[2] == 3.0f);
+    }
+    const auto snowfall = Values(weather.front(), Forecast::Variable::snowfall);
+    BOOST_TEST(std::isnan(snowfall[0]));
+    BOOST_TEST(std::isnan(snowfall[1]));
+    BOOST_TEST(snowfall[2] == 1.0f);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_json_throws) {
+    BOOST_CHECK_THROW(meteo::util::ParseForecast(R"({"hourly":{"time":[0,3600],"rain":[1.,2]}})"),
+                      boost::system::system_error);
+    BOOST_CHECK_THROW(meteo::util::ParseForecast(R"({"hourly":{"time":[0,3600],"rain":[1,2)"),
+                      boost::system::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(bracket_inside_string) {
+    const auto weather = ParseBoth(
+        R"({"timezone":"[GMT+3]","hourly_units":{"temperature_2m":"[°C]","rain":"["},)"
+        R"("hourly":{"time":[0,3600],"temperature_2m":"[1,2]","rain":[1,2],"snowfall":" [3,4]"}})");
+    BOOST_REQUIRE(weather.size() == 1);
+    const MeteoInfo& info = weather.front();
+    BOOST_TEST(info.units->temperature == "[°C]");
+    BOOST_TEST(info.units->rain == "[");
+    BOOST_REQUIRE(info.forecast.Size() == 2);
+    for (float value : Values(info, Forecast::Variable::temperature)) {
+        BOOST_TEST(std::isnan(value));
+    }
+    BOOST_TEST(Values(info, Forecast::Variable::rain) == std::vector<float>({1.0f, 2.0f}),
+               boost::test_tools::per_element());
+    for (float value : Values(info, Forecast::Variable::snowfall)) {
+        BOOST_TEST(std::isnan(value));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
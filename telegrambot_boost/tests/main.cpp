@@ -0,0 +1,6 @@
+/*
+ * Модульные тесты (Boost.Test, заголовочный вариант - отдельная библиотека не нужна)
+ *** ./tests [--run_test=normalize|numscan|forecast|snapshot|asyncutil|fileutil|reply]
+ */
+#define BOOST_TEST_MODULE telegrambot_boost
+#include <boost/test/included/unit_test.hpp>
@@ -0,0 +1,35 @@
+#include "../normalize.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(normalize)
+
+BOOST_AUTO_TEST_CASE(spellings_of_one_town_give_one_key) {
+    const normalize::Normalizer normalizer;
+    for (const char* name : {"Москва", "москва", "г. Москва", "Moscow", "moskva", "Москва, Россия", "Россия, Москва",
+                             "Moscow, Russia"}) {
+        BOOST_TEST(normalizer.Key(name) == "moskva", name);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(towns_of_one_country_give_different_keys) {
+    const normalize::Normalizer normalizer;
+    BOOST_TEST(normalizer.Key("Россия, Казань") == "kazan");
+    BOOST_TEST(normalizer.Key("Россия, Москва") == "moskva");
+    BOOST_TEST(normalizer.Key("Россия, Республика Татарстан, Казань") !=
+               normalizer.Key("Россия, Республика Татарстан, Альметьевск"));
+}
+
+BOOST_AUTO_TEST_CASE(region_stays_in_key) {
+    const normalize::Normalizer normalizer;
+    BOOST_TEST(normalizer.Key("Татарстан, Казань") == "tatarstan, kazan");
+    BOOST_TEST(normalizer.Key("Татарстан, Казань") != normalizer.Key("Татарстан, Набережные Челны"));
+    BOOST_TEST(normalizer.Key("Березовка, Пермский край") != normalizer.Key("Березовка, Красноярский край"));
+}
+
+BOOST_AUTO_TEST_CASE(country_alone_is_kept) {
+    BOOST_TEST(normalize::BaseKey("Россия") == "rossiya");
+    BOOST_TEST(normalize::BaseKey(" , ") == "");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,100 @@
+#include "../numscan.h"
+
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Разбор обеими реализациями; результаты должны совпадать
+std::vector<float> Decode(std::string_view text, bool& ok) {
+    std::vector<float> values;
+    std::vector<float> scalar;
+    const char* next = num_scan::DecodeFloatArray(text.data(), text.data() + text.size(), values);
+    const char* next_scalar = num_scan::DecodeFloatArrayScalar(text.data(), text.data() + text.size(), scalar);
+    BOOST_TEST(next == next_scalar, text);
+    BOOST_TEST(values.size() == scalar.size(), text);
+    ok = next != nullptr;
+    if (ok) {
+        BOOST_TEST((next == text.data() + text.size()), text);
+    } else {
+        BOOST_TEST(values.empty(), text);
+    }
+    return values;
+}
+
+bool Accepted(std::string_view text) {
+    bool ok{};
+    Decode(text, ok);
+    return ok;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(numscan)
+
+BOOST_AUTO_TEST_CASE(numbers_and_null) {
+    bool ok{};
+    const auto values = Decode("[1.5, null,-0.25 ,0,12,1e2,-3E-1]", ok);
+    BOOST_REQUIRE(ok);
+    BOOST_REQUIRE(values.size() == 7);
+    BOOST_TEST(values[0] == 1.5f);
+    BOOST_TEST(std::isnan(values[1]));
+    BOOST_TEST(values[2] == -0.25f);
+    BOOST_TEST(values[3] == 0.0f);
+    BOOST_TEST(values[4] == 12.0f);
+    BOOST_TEST(values[5] == 100.0f);
+    BOOST_TEST(values[6] == -0.3f);
+}
+
+BOOST_AUTO_TEST_CASE(long_array_crosses_blocks) {
+    std::string text{"["};
+    for (int i = 0; i < 100; ++i) {
+        text += (i != 0 ? "," : "") + std::to_string(i);
+    }
+    text += "]";
+    bool ok{};
+    const auto values = Decode(text, ok);
+    BOOST_REQUIRE(ok);
+    BOOST_REQUIRE(values.size() == 100);
+    BOOST_TEST(values[99] == 99.0f);
+}
+
+BOOST_AUTO_TEST_CASE(empty_array) {
+    BOOST_TEST(Accepted("[]"));
+    BOOST_TEST(Accepted("[ ]"));
+    BOOST_TEST(!Accepted("[,]"));
+    BOOST_TEST(!Accepted("[1,]"));
+    BOOST_TEST(!Accepted("[,1]"));
+}
+
+BOOST_AUTO_TEST_CASE(non_json_numbers_are_rejected) {
+    for (const char* text : {"[1.]", "[.5]", "[01]", "[-01]", "[+1]", "[1e]", "[1e+]", "[-]", "[1.e2]", "[inf]",
+                             "[nan]", "[-inf]", "[0x10]", "[1 2]", "[nul]", "[NULL]"}) {
+        BOOST_TEST(!Accepted(text), text);
+    }
+    for (const char* text : {"[0]", "[-0]", "[0.5]", "[10]", "[1e5]", "[1E+5]", "[1.5e-3]"}) {
+        BOOST_TEST(Accepted(text), text);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(unsupported_arrays_are_left_to_parser) {
+    for (const char* text : {"[\"1\",2]", "[[1],2]", "[{\"a\":1}]", "[true]", "[1,2", "1,2]", ""}) {
+        BOOST_TEST(!Accepted(text), text);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(values_are_appended) {
+    const std::string_view text{"[2,3]"};
+    std::vector<float> values{1.0f};
+    BOOST_REQUIRE(num_scan::DecodeFloatArray(text.data(), text.data() + text.size(), values) != nullptr);
+    BOOST_TEST(values == std::vector<float>({1.0f, 2.0f, 3.0f}), boost::test_tools::per_element());
+
+    const std::string_view bad{"[4,x]"};
+    BOOST_TEST(num_scan::DecodeFloatArray(bad.data(), bad.data() + bad.size(), values) == nullptr);
+    BOOST_TEST(values.size() == 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
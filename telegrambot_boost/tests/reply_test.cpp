@@ -0,0 +1,106 @@
+#include "../meteobot.h"
+#include "../reply.h"
+
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace {
+
+using meteo::Forecast;
+using meteo::MeteoInfo;
+using meteo::TimePoint;
+
+constexpr static int64_t START{1700000000};
+constexpr static int32_t STEP{3600};
+
+MeteoInfo MakeInfo(float temperature) {
+    MeteoInfo info;
+    info.valid = true;
+    info.forecast = Forecast(START, STEP, 10800, 48);
+    for (float& value : info.forecast.Values(Forecast::Variable::temperature)) {
+        value = temperature;
+    }
+    return info;
+}
+
+TimePoint At(int64_t time) {
+    return TimePoint{std::chrono::seconds{time}};
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(reply)
+
+BOOST_AUTO_TEST_CASE(hit_returns_same_reply) {
+    MeteoInfo info = MakeInfo(12.5f);
+    const auto now = At(START + 100);
+    const telega::ReplyPtr first = info.CachedReply("Казань", now);
+    BOOST_REQUIRE(first);
+    BOOST_TEST(first->Body("42").find("Казань") != std::string::npos);
+    BOOST_TEST((info.CachedReply("Казань", now) == first));
+    BOOST_TEST((info.CachedReply("Казань", At(START + STEP - 1)) == first));   // тот же срок прогноза
+    BOOST_TEST(info.replies.size() == 1);
+
+    // другое место в той же ячейке - свой ответ
+    const telega::ReplyPtr other = info.CachedReply("Зеленодольск", now);
+    BOOST_TEST((other != first));
+    BOOST_TEST(other->Body("42").find("Зеленодольск") != std::string::npos);
+    BOOST_TEST(info.replies.size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(replies_are_limited) {
+    MeteoInfo info = MakeInfo(12.5f);
+    const auto now = At(START + 100);
+    for (size_t i = 0; i < 3 * MeteoInfo::MAX_REPLIES; ++i) {
+        BOOST_REQUIRE(info.CachedReply("Место " + std::to_string(i), now));
+        BOOST_TEST(info.replies.size() <= MeteoInfo::MAX_REPLIES);
+    }
+    BOOST_TEST(info.replies.size() == MeteoInfo::MAX_REPLIES);
+    // вытесняются самые старые ответы, последний остаётся
+    const auto last = info.CachedReply("Место " + std::to_string(3 * MeteoInfo::MAX_REPLIES - 1), now);
+    BOOST_TEST((info.replies.back().second == last));
+    BOOST_TEST(info.replies.front().first != "Место 0");
+}
+
+BOOST_AUTO_TEST_CASE(replies_are_cleared_on_next_slot) {
+    MeteoInfo info = MakeInfo(12.5f);
+    const telega::ReplyPtr first = info.CachedReply("Казань", At(START + 100));
+    info.CachedReply("Зеленодольск", At(START + 100));
+    const telega::ReplyPtr next = info.CachedReply("Казань", At(START + STEP));
+    BOOST_TEST((next != first));
+    BOOST_TEST(info.replies.size() == 1);
+    BOOST_TEST(info.replies_slot == 1u);
+}
+
+BOOST_AUTO_TEST_CASE(replies_are_cleared_on_refresh) {
+    MeteoInfo info = MakeInfo(12.5f);
+    const auto now = At(START + 100);
+    const telega::ReplyPtr old_reply = info.CachedReply("Казань", now);
+    const uint64_t hits = info.hits = 3;
+
+    info.Refresh(MakeInfo(-7.5f));
+    BOOST_TEST(info.replies.empty());
+    BOOST_TEST(info.hits == hits);
+    const telega::ReplyPtr new_reply = info.CachedReply("Казань", now);
+    BOOST_TEST((new_reply != old_reply));
+    BOOST_TEST(new_reply->Body("42").find("-7.5") != std::string::npos);
+}
+
+// Ответ вне прогноза (ошибка) не запоминается
+BOOST_AUTO_TEST_CASE(reply_outside_forecast_is_not_cached) {
+    MeteoInfo info = MakeInfo(12.5f);
+    BOOST_REQUIRE(info.CachedReply("Казань", At(START - 1)));
+    BOOST_REQUIRE(info.CachedReply("Казань", At(START + 47 * STEP)));    // следующего срока нет
+    BOOST_TEST(info.replies.empty());
+}
+
+BOOST_AUTO_TEST_CASE(approx_bytes_include_replies) {
+    MeteoInfo info = MakeInfo(12.5f);
+    const size_t empty = info.ApproxBytes();
+    info.CachedReply("Казань", At(START + 100));
+    BOOST_TEST(info.ApproxBytes() > empty);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
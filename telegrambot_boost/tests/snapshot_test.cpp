@@ -0,0 +1,266 @@
+#include "../fileutil.h"
+#include "../httpspool.h"
+#include "../meteobot.h"
+#include "../reply.h"
+
+#include <boost/asio.hpp>
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using meteo::Forecast;
+using meteo::GridCell;
+using meteo::MeteoInfo;
+
+// Формат снимка MeteoBot::SerializeSnapshot, при смене версии формата тест нужно обновить
+constexpr static uint32_t SNAPSHOT_MAGIC{0x504E534D};
+constexpr static uint32_t SNAPSHOT_VERSION{3};
+constexpr static double GRID_RESOLUTION{0.1};
+
+struct SnapshotTown {
+    std::string key;
+    GridCell cell;
+    std::string address;
+};
+
+MeteoInfo MakeInfo(int64_t start, size_t size) {
+    MeteoInfo info;
+    info.valid = true;
+    info.hits = 7;
+    info.forecast = Forecast(start, 3600, 10800, size);
+    const auto block = info.forecast.Block();
+    for (size_t i = 0; i < block.size(); ++i) {
+        block[i] = static_cast<float>(i) / 4;
+    }
+    return info;
+}
+
+std::string MakeSnapshot(const std::vector<SnapshotTown>& towns,
+                         const std::vector<std::pair<GridCell, const MeteoInfo*>>& forecasts) {
+    file_util::BinaryWriter writer;
+    writer.Put<uint32_t>(SNAPSHOT_MAGIC);
+    writer.Put<uint32_t>(SNAPSHOT_VERSION);
+    writer.Put<double>(GRID_RESOLUTION);
+    writer.Put<int64_t>(0);
+    writer.Put<uint32_t>(static_cast<uint32_t>(towns.size()));
+    for (const auto& town : towns) {
+        writer.PutString(town.key);
+        writer.Put<int32_t>(town.cell.lat_idx);
+        writer.Put<int32_t>(town.cell.lon_idx);
+        writer.PutString(town.address);
+    }
+    writer.Put<uint32_t>(static_cast<uint32_t>(forecasts.size()));
+    for (const auto& [cell, info] : forecasts) {
+        writer.Put<int32_t>(cell.lat_idx);
+        writer.Put<int32_t>(cell.lon_idx);
+        meteo::util::SerializeForecast(writer, *info);
+    }
+    return std::string(writer.Data());
+}
+
+int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// MeteoBot со снимком во временном каталоге, сеть не используется
+struct SnapshotFixture {
+    SnapshotFixture() {
+        std::filesystem::create_directories(dir);
+        settings.snapshot_file = (dir / "meteo_snapshot.bin").string();
+        settings.grid_resolution = GRID_RESOLUTION;
+    }
+    ~SnapshotFixture() {
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+    }
+
+    std::unique_ptr<meteo::MeteoBot> MakeBot() {
+        return std::make_unique<meteo::MeteoBot>(ioc.get_executor(), pool, settings);
+    }
+
+    void WriteSnapshot(std::string_view data) {
+        file_util::WriteFileAtomic(settings.snapshot_file, data, false);
+    }
+
+    // Снимок с одним городом (Казань) и его прогнозом
+    std::string GoodSnapshot() {
+        return MakeSnapshot({{"kazan", kazan, "Казань"}}, {{kazan, &kazan_info}});
+    }
+
+    // Снимок с ещё одним городом, испорченный порчей func
+    template <typename Func>
+    std::string DamagedSnapshot(Func func) {
+        std::string data = MakeSnapshot({{"kazan", kazan, "Казань"}, {"moskva", moskva, "Москва"}},
+                                        {{kazan, &kazan_info}, {moskva, &moskva_info}});
+        func(data);
+        return data;
+    }
+
+    std::filesystem::path dir{std::filesystem::temp_directory_path() /
+                              ("telegrambot_tests_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()))};
+    boost::asio::io_context ioc;
+    std::shared_ptr<https_pool::HttpsPool> pool{std::make_shared<https_pool::HttpsPool>(ioc.get_executor())};
+    meteo::MeteoSettings settings;
+    GridCell kazan{558, 491};
+    GridCell moskva{558, 376};
+    MeteoInfo kazan_info{MakeInfo(Now() - 3600, 48)};
+    MeteoInfo moskva_info{MakeInfo(Now() - 3600, 48)};
+};
+
+// Кэши остались такими, какими их загрузил GoodSnapshot
+void CheckGoodSnapshotLoaded(const meteo::MeteoBot& bot) {
+    BOOST_TEST(bot.GetTownStats().entries == 1);
+    BOOST_TEST(bot.GetCacheStats().entries == 1);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(snapshot)
+
+BOOST_AUTO_TEST_CASE(forecast_round_trip) {
+    for (size_t size : {size_t{0}, size_t{1}, size_t{48}}) {
+        MeteoInfo info = MakeInfo(1700000000, size);
+        meteo::Units units;
+        units.temperature = "°F";
+        info.units = meteo::InternUnits(units);
+        info.updated_time = meteo::TimePoint{std::chrono::milliseconds{1700000000123}};
+
+        file_util::BinaryWriter writer;
+        meteo::util::SerializeForecast(writer, info);
+        file_util::BinaryReader reader(writer.Data());
+        const MeteoInfo loaded = meteo::util::DeserializeForecast(reader);
+        BOOST_TEST(reader.AtEnd());
+
+        BOOST_TEST(loaded.valid);
+        BOOST_TEST(loaded.hits == info.hits);
+        BOOST_TEST((loaded.updated_time == info.updated_time));
+        BOOST_TEST(loaded.units == info.units);
+        BOOST_TEST(loaded.forecast.Start() == info.forecast.Start());
+        BOOST_TEST(loaded.forecast.Step() == info.forecast.Step());
+        BOOST_TEST(loaded.forecast.UtcOffset() == info.forecast.UtcOffset());
+        BOOST_REQUIRE(loaded.forecast.Size() == size);
+        const auto expected = info.forecast.Block();
+        const auto actual = loaded.forecast.Block();
+        BOOST_TEST(std::memcmp(actual.data(), expected.data(), expected.size_bytes()) == 0);
+    }
+}
+
+// Размер прогноза проверяется до выделения памяти
+BOOST_AUTO_TEST_CASE(forecast_size_beyond_data) {
+    file_util::BinaryWriter writer;
+    meteo::util::SerializeForecast(writer, MakeInfo(1700000000, 4));
+    std::string data(writer.Data());
+    const size_t size_offset = data.size() - 4 * Forecast::VARIABLES * sizeof(float) - sizeof(uint32_t);
+
+    for (uint32_t size : {uint32_t{5}, uint32_t{0xFFFFFFFF}}) {
+        std::memcpy(data.data() + size_offset, &size, sizeof(size));
+        file_util::BinaryReader reader(data);
+        BOOST_CHECK_THROW(meteo::util::DeserializeForecast(reader), std::out_of_range);
+    }
+
+    std::string truncated(writer.Data());
+    truncated.pop_back();
+    file_util::BinaryReader reader(truncated);
+    BOOST_CHECK_THROW(meteo::util::DeserializeForecast(reader), std::out_of_range);
+}
+
+BOOST_FIXTURE_TEST_CASE(bot_round_trip, SnapshotFixture) {
+    WriteSnapshot(GoodSnapshot());
+    {
+        auto bot = MakeBot();
+        bot->LoadSnapshot();
+        CheckGoodSnapshotLoaded(*bot);
+        std::filesystem::remove(settings.snapshot_file);
+        bot->SaveSnapshot();
+    }
+    BOOST_REQUIRE(std::filesystem::exists(settings.snapshot_file));
+
+    auto bot = MakeBot();
+    bot->LoadSnapshot();
+    CheckGoodSnapshotLoaded(*bot);
+
+    // город и прогноз из снимка: ответ без запросов к geocode и open-meteo
+    telega::ReplyPtr reply;
+    boost::asio::co_spawn(ioc, [&]() -> boost::asio::awaitable<void> {
+        reply = co_await bot->GetWeather("Казань");
+    }, boost::asio::detached);
+    ioc.run();
+    BOOST_REQUIRE(reply);
+    BOOST_TEST(reply->Body("42").find("Казань") != std::string::npos);
+    BOOST_TEST(bot->GetRequestStats().geocode_requests == 0);
+    BOOST_TEST(bot->GetRequestStats().forecast_requests == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(damaged_snapshot_is_not_loaded, SnapshotFixture) {
+    const std::vector<std::pair<const char*, std::string>> damaged{
+        {"truncated", DamagedSnapshot([](std::string& data) { data.resize(data.size() - 10); })},
+        {"trailing data", DamagedSnapshot([](std::string& data) { data += '\0'; })},
+        {"forecast size beyond data", DamagedSnapshot([](std::string& data) {
+            // размер последнего прогноза стоит перед его блоком значений
+            const uint32_t size = 0xFFFFFFFF;
+            std::memcpy(data.data() + data.size() - 48 * Forecast::VARIABLES * sizeof(float) - sizeof(size),
+                        &size, sizeof(size));
+        })},
+        {"town count beyond data", DamagedSnapshot([](std::string& data) {
+            const uint32_t count = 1000;
+            std::memcpy(data.data() + 2 * sizeof(uint32_t) + sizeof(double) + sizeof(int64_t), &count, sizeof(count));
+        })},
+        {"unknown version", DamagedSnapshot([](std::string& data) {
+            const uint32_t version = SNAPSHOT_VERSION + 1;
+            std::memcpy(data.data() + sizeof(uint32_t), &version, sizeof(version));
+        })},
+    };
+
+    auto bot = MakeBot();
+    WriteSnapshot(GoodSnapshot());
+    bot->LoadSnapshot();
+    CheckGoodSnapshotLoaded(*bot);
+
+    // испорченный снимок не загружается совсем: второй город и его прогноз не появляются в кэшах
+    for (const auto& [name, data] : damaged) {
+        BOOST_TEST_CONTEXT(name) {
+            WriteSnapshot(data);
+            bot->LoadSnapshot();
+            CheckGoodSnapshotLoaded(*bot);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(other_grid_resolution_is_skipped, SnapshotFixture) {
+    WriteSnapshot(GoodSnapshot());
+    settings.grid_resolution = 0.25;
+    auto bot = MakeBot();
+    bot->LoadSnapshot();
+    BOOST_TEST(bot->GetTownStats().entries == 0);
+    BOOST_TEST(bot->GetCacheStats().entries == 0);
+}
+
+BOOST_AUTO_TEST_CASE(forecast_slot) {
+    const Forecast forecast(1000, 3600, 0, 4);
+    BOOST_TEST(!forecast.Slot(999).has_value());
+    BOOST_TEST((forecast.Slot(1000) == std::optional<size_t>{0}));
+    BOOST_TEST((forecast.Slot(1000 + 3599) == std::optional<size_t>{0}));
+    BOOST_TEST((forecast.Slot(1000 + 3600) == std::optional<size_t>{1}));
+    BOOST_TEST((forecast.Slot(1000 + 3 * 3600) == std::optional<size_t>{3}));    // последний срок
+    BOOST_TEST((forecast.Slot(1000 + 4 * 3600 - 1) == std::optional<size_t>{3}));
+    BOOST_TEST(!forecast.Slot(1000 + 4 * 3600).has_value());
+    for (size_t i = 0; i < forecast.Size(); ++i) {
+        BOOST_TEST((forecast.Slot(forecast.Time(i)) == std::optional<size_t>{i}));
+    }
+
+    BOOST_TEST(!Forecast().Slot(1000).has_value());
+    BOOST_TEST(!Forecast(1000, 3600, 0, 0).Slot(1000).has_value());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
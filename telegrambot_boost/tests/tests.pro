@@ -0,0 +1,60 @@
+TEMPLATE = app
+CONFIG -= qt
+CONFIG += console c++20
+CONFIG += static
+
+# записанные ответы сервисов берутся из bench/payloads
+DEFINES += TEST_DATA_DIR=\\\"$$PWD/../bench\\\"
+
+win32: {
+    INCLUDEPATH += "C:/boost"
+    INCLUDEPATH += "C:/Program Files/FireDaemon OpenSSL 3/include"
+    LIBS += -L"C:/boost/lib64-msvc-14.3" -lboost_system*  -lboost_json* -lboost_url* -lboost_log-*
+    LIBS += -L"C:/Program Files/FireDaemon OpenSSL 3/lib" -llibssl -llibcrypto
+}
+linux {
+    LIBS += -lboost_system -lboost_json -lboost_url -lboost_log_setup -lboost_log -lboost_thread
+    LIBS += -lcrypto -lssl
+}
+SOURCES += \
+    ../asyncutil.cpp \
+    ../fileutil.cpp \
+    ../gazetteer.cpp \
+    ../geocode.cpp \
+    ../httpsclient.cpp \
+    ../httpserver.cpp \
+    ../httpspool.cpp \
+    ../logger.cpp \
+    ../meteobot.cpp \
+    ../metrics.cpp \
+    ../normalize.cpp \
+    ../numscan.cpp \
+    ../reply.cpp \
+    ../telegrambot.cpp \
+    ../tracing.cpp \
+    asyncutil_test.cpp \
+    fileutil_test.cpp \
+    forecast_test.cpp \
+    main.cpp \
+    normalize_test.cpp \
+    numscan_test.cpp \
+    reply_test.cpp \
+    snapshot_test.cpp
+
+HEADERS += \
+    ../asyncutil.h \
+    ../fileutil.h \
+    ../gazetteer.h \
+    ../geocode.h \
+    ../httpsclient.h \
+    ../httpserver.h \
+    ../httpspool.h \
+    ../logger.h \
+    ../lrucache.h \
+    ../meteobot.h \
+    ../metrics.h \
+    ../normalize.h \
+    ../numscan.h \
+    ../reply.h \
+    ../telegrambot.h \
+    ../tracing.h
@@ -0,0 +1,291 @@
+#include "logger.h"
+#include "tracing.h"
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+
+namespace tracing {
+
+namespace {
+
+/* Фоновая запись трасс. Трассы объединяются в массив JSON: "[" при открытии файла, запятая перед каждой
+ * трассой, кроме первой, и "]" при остановке. Файл без закрывающей скобки (после аварийного завершения)
+ * chrome://tracing тоже открывает */
+class TraceWriter {
+public:
+    explicit TraceWriter(TraceSettings settings)
+        : settings_(std::move(settings))
+        , out_(settings_.file, std::ios::binary | std::ios::trunc)
+        , writer_([this] { WriteLoop(); }) {
+        if (!out_) {
+            logger::LogError(std::format("Failed to open {}", settings_.file), "tracing::Start");
+        }
+    }
+
+    ~TraceWriter() {
+        Close();
+    }
+
+    // Дожидается записи оставшихся трасс и закрывает массив
+    void Close() {
+        if (!writer_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        changed_.notify_one();
+        writer_.join();
+    }
+
+    const TraceSettings& Settings() const noexcept {
+        return settings_;
+    }
+
+    void Push(std::string trace) {
+        {
+            std::lock_guard lock(mutex_);
+            if (pending_.size() >= settings_.max_pending) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            pending_.push_back(std::move(trace));
+        }
+        changed_.notify_one();
+    }
+
+    uint64_t Written() const noexcept {
+        return written_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Dropped() const noexcept {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    void WriteLoop() {
+        out_ << "[\n";
+        bool first = true;
+        std::deque<std::string> batch;
+        std::unique_lock lock(mutex_);
+        while (true) {
+            changed_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+            batch.swap(pending_);
+            const bool stop = stop_;
+            lock.unlock();
+            for (const auto& trace : batch) {
+                if (!first) {
+                    out_ << ",\n";
+                }
+                first = false;
+                out_ << trace;
+            }
+            written_.fetch_add(batch.size(), std::memory_order_relaxed);
+            batch.clear();
+            out_.flush();
+            lock.lock();
+            if (stop && pending_.empty()) {
+                break;
+            }
+        }
+        out_ << "\n]\n";
+        out_.flush();
+    }
+
+    const TraceSettings settings_;
+    std::ofstream out_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<std::string> pending_;
+    bool stop_{false};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::thread writer_;
+};
+
+std::mutex writer_mutex;
+std::unique_ptr<TraceWriter> writer;
+std::atomic<bool> active{false};
+std::atomic<uint64_t> next_id{1};
+uint64_t written_total{};   // трасс, записанных до последнего Stop, защищён writer_mutex
+uint64_t dropped_total{};
+
+// Время в Chrome trace - микросекунды от произвольной точки отсчёта, одной для всех трасс
+int64_t Micros(Trace::Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+void AppendEvent(std::string& out, std::string_view name, Trace::Clock::time_point start,
+                 Trace::Clock::time_point end, uint64_t id, std::string_view args) {
+    out += R"({"name":)";
+    logger::util::AppendJsonString(out, name);
+    out += std::format(R"(,"cat":"bot","ph":"X","ts":{},"dur":{},"pid":1,"tid":{},"args":{{{}}}}})",
+                       Micros(start), Micros(end) - Micros(start), id, args);
+}
+
+}
+
+/* -------- Trace -------- */
+
+Trace::Trace(uint64_t id, std::string_view name)
+    : id_(id)
+    , start_(Clock::now())
+    , name_(name) {}
+
+/* Решение о записи принимается по завершении трассы, когда известна её длительность:
+ * медленные трассы записываются независимо от выборки */
+Trace::~Trace() {
+    const auto end = Clock::now();
+    std::lock_guard lock(writer_mutex);
+    if (!writer) {
+        return;
+    }
+    const auto& settings = writer->Settings();
+    const bool slow = end - start_ >= settings.slow_threshold;
+    const bool sampled = settings.sample_every != 0 && id_ % settings.sample_every == 0;
+    if (slow || sampled) {
+        writer->Push(Serialize(end, slow));
+    }
+}
+
+uint64_t Trace::Id() const noexcept {
+    return id_;
+}
+
+void Trace::Arg(std::string_view key, std::string_view value) {
+    AppendArg(args_, key, value);
+}
+
+void Trace::AddSpan(std::string_view name, Clock::time_point start, Clock::time_point end) {
+    events_.push_back({.name = std::string(name), .start = start, .end = end});
+}
+
+void Trace::AppendArg(std::string& args, std::string_view key, std::string_view value) {
+    if (!args.empty()) {
+        args += ',';
+    }
+    logger::util::AppendJsonString(args, key);
+    args += ':';
+    logger::util::AppendJsonString(args, value);
+}
+
+std::string Trace::Serialize(Clock::time_point end, bool slow) const {
+    std::string args = args_;
+    AppendArg(args, "trace_id", std::to_string(id_));
+    if (slow) {
+        AppendArg(args, "slow", "true");
+    }
+    std::string out;
+    AppendEvent(out, name_, start_, end, id_, args);
+    for (const auto& event : events_) {
+        out += ",\n";
+        // незавершённый интервал (трасса завершилась раньше) обрезается концом трассы
+        AppendEvent(out, event.name, event.start, event.end == Clock::time_point{} ? end : event.end, id_, event.args);
+    }
+    return out;
+}
+
+/* -------- Span -------- */
+
+Span::Span(const TracePtr& trace, std::string_view name)
+    : trace_(trace.get()) {
+    if (trace_) {
+        index_ = trace_->events_.size();
+        trace_->events_.push_back({.name = std::string(name), .start = Trace::Clock::now()});
+    }
+}
+
+Span::~Span() {
+    if (trace_) {
+        trace_->events_[index_].end = Trace::Clock::now();
+    }
+}
+
+void Span::Arg(std::string_view key, std::string_view value) {
+    if (trace_) {
+        Trace::AppendArg(trace_->events_[index_].args, key, value);
+    }
+}
+
+/* -------- Управление -------- */
+
+void Start(TraceSettings settings) {
+    std::lock_guard lock(writer_mutex);
+    if (writer) {
+        return;
+    }
+    writer = std::make_unique<TraceWriter>(std::move(settings));
+    active.store(true, std::memory_order_relaxed);
+}
+
+void Stop() {
+    std::lock_guard lock(writer_mutex);
+    if (!writer) {
+        return;
+    }
+    active.store(false, std::memory_order_relaxed);
+    writer->Close();
+    written_total += writer->Written();
+    dropped_total += writer->Dropped();
+    writer.reset();
+}
+
+TracePtr NewTrace(std::string_view name) {
+    if (!active.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return std::make_shared<Trace>(next_id.fetch_add(1, std::memory_order_relaxed), name);
+}
+
+std::string Pseudonym(std::string_view value) {
+    constexpr static char HEX[]{"0123456789abcdef"};
+    constexpr static size_t PSEUDONYM_BYTES{8};
+
+    // ключ создаётся один раз за запуск и нигде не сохраняется
+    static const std::array<unsigned char, 32> key = [] {
+        std::array<unsigned char, 32> bytes{};
+        if (RAND_bytes(bytes.data(), static_cast<int>(bytes.size())) != 1) {
+            std::random_device random;
+            for (auto& byte : bytes) {
+                byte = static_cast<unsigned char>(random());
+            }
+        }
+        return bytes;
+    }();
+
+    std::array<unsigned char, EVP_MAX_MD_SIZE> digest{};
+    unsigned int digest_size{};
+    HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()), reinterpret_cast<const unsigned char*>(value.data()),
+         value.size(), digest.data(), &digest_size);
+    std::string result;
+    result.reserve(PSEUDONYM_BYTES * 2);
+    for (size_t i = 0; i < PSEUDONYM_BYTES && i < digest_size; ++i) {
+        result += HEX[digest[i] >> 4];
+        result += HEX[digest[i] & 0x0F];
+    }
+    return result;
+}
+
+uint64_t Written() noexcept {
+    std::lock_guard lock(writer_mutex);
+    return written_total + (writer ? writer->Written() : 0);
+}
+
+uint64_t Dropped() noexcept {
+    std::lock_guard lock(writer_mutex);
+    return dropped_total + (writer ? writer->Dropped() : 0);
+}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+/*
+ * Трассировка обработки сообщений: каждое обновление telegram получает трассу (Trace),
+ * этапы обработки (ожидание в очереди, getUpdates, geocode, обновление прогноза, форматирование, sendMessage)
+ * записываются в неё как интервалы (Span)
+ * Трасса передаётся явно (TracePtr) - корутины одного потока чередуются, поэтому thread_local контекст не подходит.
+ * nullptr - трассировка выключена, Span в этом случае ничего не делает
+ *
+ * После завершения трассы (уничтожения последнего TracePtr) решается, записывать ли её:
+ * - каждая sample_every-я трасса (выборка);
+ * - любая трасса дольше slow_threshold (медленные записываются всегда)
+ * Запись в формате Chrome trace event (массив JSON, открывается в chrome://tracing или ui.perfetto.dev),
+ * у каждой трассы своя строка (tid = номер трассы). Файл пишет фоновый поток
+ * Файл хранится для последующего анализа, поэтому данные пользователей (chat_id) записываются только
+ * в виде псевдонима (Pseudonym), текст сообщений не записывается
+ *
+ * Использование:
+ *** tracing::Start({.file = "trace.json", .sample_every = 100, .slow_threshold = std::chrono::seconds{2}});
+ *** auto trace = tracing::NewTrace("update");
+ *** { tracing::Span span(trace, "geocode"); span.Arg("source", "upstream"); co_await ...; }
+ *** tracing::Stop(); // дописывает оставшиеся трассы
+ */
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tracing {
+
+struct TraceSettings {
+    std::string file{"trace.json"};
+    uint32_t sample_every{100};                         // записывается каждая N-я трасса, 0 - только медленные
+    std::chrono::milliseconds slow_threshold{2000};     // трассы не короче записываются всегда
+    size_t max_pending{1024};                           // трасс в очереди записи, при переполнении отбрасываются
+};
+
+class Trace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Trace(uint64_t id, std::string_view name);
+    ~Trace(); // передаёт трассу на запись
+
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    uint64_t Id() const noexcept;
+
+    // Аргументы корневого интервала
+    void Arg(std::string_view key, std::string_view value);
+    // Интервал с известными началом и концом (например, общий для нескольких трасс запрос getUpdates)
+    void AddSpan(std::string_view name, Clock::time_point start, Clock::time_point end);
+
+private:
+    friend class Span;
+
+    struct Event {
+        std::string name;
+        Clock::time_point start;
+        Clock::time_point end;
+        std::string args;   // пары "ключ":"значение" через запятую, без фигурных скобок
+    };
+
+    std::string Serialize(Clock::time_point end, bool slow) const;
+    static void AppendArg(std::string& args, std::string_view key, std::string_view value);
+
+    const uint64_t id_;
+    const Clock::time_point start_;
+    std::string name_;
+    std::string args_;
+    std::vector<Event> events_;
+};
+
+using TracePtr = std::shared_ptr<Trace>;
+
+// Интервал от создания до уничтожения
+class Span {
+public:
+    Span(const TracePtr& trace, std::string_view name);
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    void Arg(std::string_view key, std::string_view value);
+
+private:
+    Trace* trace_;
+    size_t index_{};
+};
+
+void Start(TraceSettings settings = {});
+void Stop();
+
+// nullptr, если трассировка не запущена
+TracePtr NewTrace(std::string_view name);
+
+/* Псевдоним для записи в трассу: HMAC-SHA256 со случайным ключом процесса, первые 8 байт в hex
+ * Одно значение в пределах запуска даёт один псевдоним (трассы одного чата можно связать),
+ * исходное значение по файлу трасс не восстановить */
+std::string Pseudonym(std::string_view value);
+
+uint64_t Written() noexcept;    // записано трасс
+uint64_t Dropped() noexcept;    // отброшено при переполнении очереди записи
+
+}